@@ -21,6 +21,11 @@
 
 #include "atresttfExport.h"
 
+struct FT_FaceRec_;
+struct FT_GlyphRec_;
+struct FT_LibraryRec_;
+struct FT_StrokerRec_;
+
 namespace april
 {
 	class Texture;
@@ -28,6 +33,8 @@ namespace april
 
 namespace atresttf
 {
+	class FontBlob;
+
 	/// @brief Defines a font object that can load font definitions from TTF files.
 	class atresttfExport FontTtf : public atres::FontDynamic
 	{
@@ -140,18 +147,87 @@ namespace atresttf
 		/// @return The kerning value.
 		float getKerning(unsigned int previousCharCode, unsigned int charCode);
 
+		/// @brief Whether scaled text uses glyphs rasterized at the nearest power-of-sqrt(2) size instead of scaling the glyphs of the base size.
+		/// @note Each size bucket is a separate font with its own textures. Buckets that are not used for a while are destroyed.
+		HL_DEFINE_IS(sizeBuckets, SizeBuckets);
+		/// @brief Sets whether scaled text uses glyphs rasterized at the nearest power-of-sqrt(2) size.
+		/// @param[in] value Whether scaled text uses size buckets.
+		void setSizeBuckets(bool value);
+		/// @brief The number of renderer frames after which an unused size bucket is destroyed.
+		HL_DEFINE_GETSET(int, sizeBucketReleaseFrames, SizeBucketReleaseFrames);
+		/// @brief Gets the number of currently existing size buckets.
+		/// @return The number of currently existing size buckets.
+		inline int getSizeBucketCount() const { return this->sizeBucketFonts.size(); }
+		/// @brief Gets the font that is used to render at a given scale.
+		/// @param[in] scale The scale of the font.
+		/// @return The font with the scale applied, a size bucket font if size buckets are used.
+		atres::Font* getScaledFont(float scale);
+		/// @brief Uploads all changed texture areas, including those of the size buckets.
+		/// @return The number of uploaded textures.
+		/// @note Also destroys size buckets that haven't been used for a while.
+		int uploadTextures();
+		/// @brief Marks a texture of this font or one of its size buckets as used in the current frame.
+		/// @param[in] texture The texture.
+		/// @return True if the texture belongs to this font or one of its size buckets.
+		bool markTextureUsed(april::Texture* texture);
+		/// @brief Whether the font or one of its size buckets needs to know which textures are used in the renderer's current frame.
+		/// @return True if the font or one of its size buckets needs to know which textures are used.
+		bool isTextureUsageTracked() const;
+		/// @brief Finds the texture coordinates of a solid white area in a texture of this font or one of its size buckets.
+		/// @param[in] texture The texture.
+		/// @param[out] uv Normalized texture coordinates of the solid white area.
+		/// @return True if the texture belongs to this font or one of its size buckets and has a solid white area.
+		bool findWhiteTexel(april::Texture* texture, gvec2f& uv) const;
+		/// @brief Gets a texture that holds only one color channel of a channel-packed texture of this font or one of its size buckets as alpha.
+		/// @param[in] texture The channel-packed texture.
+		/// @param[in] channel The color channel.
+		/// @return The channel texture or NULL if the texture doesn't belong to this font or one of its size buckets or isn't channel-packed.
+		april::Texture* getChannelTexture(april::Texture* texture, int channel);
+
 	protected:
 		/// @brief Whether to use a custom descender value that overrides the actual font's descender.
 		bool customDescender;
 		/// @brief Font filename.
 		hstr fontFilename;
 		/// @brief Font file data stream.
+		/// @note Only used when the font was created from a stream.
 		hstream fontStream;
+		/// @brief Font file data shared with other fonts that use the same font file.
+		FontBlob* fontBlob;
 		/// @brief Whether to pre-load the basic ASCII range of characters.
 		bool loadBasicAscii;
-		/// @brief Cache for calculated kerning values.
+		/// @brief Whether the font has kerning information.
+		bool kerningSupported;
+		/// @brief Directly indexed kerning values for character pairs within the Latin-1 range.
+		/// @note Created when first needed, values that were not loaded yet are marked with a special value.
+		float* kerningTable;
+		/// @brief Cache for calculated kerning values of character pairs outside of kerningTable's range.
 		/// @note Mostly used for internal optimization.
 		hmap<std::pair<unsigned int, unsigned int>, float> kerningCache;
+		/// @brief Directly indexed glyph indices of the Basic Multilingual Plane in pages of 256 characters.
+		/// @note Pages are created when first needed. A glyph index of 0 means that the font doesn't have the character.
+		unsigned int** glyphIndexPages;
+		/// @brief Glyph indices of characters outside of the Basic Multilingual Plane.
+		hmap<unsigned int, unsigned int> sparseGlyphIndices;
+		/// @brief Whether scaled text uses size buckets.
+		bool sizeBuckets;
+		/// @brief Number of frames after which an unused size bucket is destroyed.
+		int sizeBucketReleaseFrames;
+		/// @brief Fonts for the size buckets by bucket index, the bucket's size is the base size times sqrt(2) to the power of the index.
+		hmap<int, FontTtf*> sizeBucketFonts;
+		/// @brief The last renderer frame in which this font was used as size bucket.
+		int sizeBucketLastUsedFrame;
+		/// @brief Strokers for native borders by border thickness ID.
+		hmap<int, FT_StrokerRec_*> strokers;
+		/// @brief Loaded glyph outlines by glyph index, used for native borders.
+		/// @note Glyphs that don't have an outline are stored as NULL.
+		/// @note Outlines are only kept once border symbols were requested, fonts that never render borders don't keep any.
+		hmap<unsigned int, FT_GlyphRec_*> outlines;
+		/// @brief FreeType libraries used by the loader threads.
+		/// @note FreeType objects cannot be shared between threads so each loader thread uses its own.
+		harray<FT_LibraryRec_*> asyncLibraries;
+		/// @brief FreeType faces used by the loader threads, all created on the same font file data.
+		harray<FT_FaceRec_*> asyncFaces;
 
 		/// @brief Loads the font definition.
 		/// @param[in] fontFilename Font filename.
@@ -167,6 +243,15 @@ namespace atresttf
 		/// @brief Loads the font definition.
 		/// @return True if successfully loaded.
 		bool _load();
+		/// @brief Releases the font file data.
+		void _clearFontData();
+		/// @brief Creates a FreeType face from the font file data with the font's size.
+		/// @param[in] library The FreeType library.
+		/// @return The FreeType face or NULL if it could not be created.
+		FT_FaceRec_* _createFace(FT_LibraryRec_* library);
+		/// @brief Checks if characters can be loaded asynchronously in this font.
+		/// @return True if characters can be loaded asynchronously in this font.
+		bool _isAsyncLoadingSupported() const;
 		
 		/// @brief Loads an character image.
 		/// @param[in] charCode Character unicode value.
@@ -179,11 +264,84 @@ namespace atresttf
 		/// @param[out] bearingX Horizontal bearing.
 		/// @return The loaded image.
 		april::Image* _loadCharacterImage(unsigned int charCode, bool initial, float& advance, int& leftOffset, int& topOffset, float& ascender, float& descender, float& bearingX);
+		/// @brief Loads an character image from a specific FreeType face.
+		/// @param[in] face The FreeType face.
+		/// @param[in] glyphIndex Index of the glyph in the face.
+		/// @param[out] advance Horizontal advance value.
+		/// @param[out] leftOffset Horizontal offset from the left boundary of the bitmap.
+		/// @param[out] topOffset Vertical offset from the top boundary of the bitmap.
+		/// @param[out] ascender Ascender value.
+		/// @param[out] descender Descender value.
+		/// @param[out] bearingX Horizontal bearing.
+		/// @param[out] outline If not NULL, a copy of the glyph's outline before rendering or NULL if the glyph is not an outline.
+		/// @return The loaded image.
+		april::Image* _loadCharacterImage(FT_FaceRec_* face, unsigned int glyphIndex, float& advance, int& leftOffset, int& topOffset, float& ascender, float& descender, float& bearingX,
+			FT_GlyphRec_** outline = NULL);
+		/// @brief Loads only the metrics of a character without rendering its image.
+		/// @param[in] charCode Character unicode value.
+		/// @param[out] container The character metrics.
+		/// @param[out] imageWidth Width of the character image.
+		/// @param[out] imageHeight Height of the character image.
+		/// @return True if successful.
+		/// @note Characters that are not outlines are not loaded asynchronously since they don't need rendering.
+		bool _loadCharacterMetrics(unsigned int charCode, CharacterImageContainer& container, int& imageWidth, int& imageHeight);
+		/// @brief Prepares the FreeType objects for the loader threads before they are started.
+		/// @param[in] threadCount The number of loader threads.
+		void _prepareAsyncLoading(int threadCount);
+		/// @brief Destroys the FreeType objects of loader threads.
+		/// @param[in] threadCount The number of loader threads whose FreeType objects are kept.
+		void _destroyAsyncFaces(int threadCount);
+		/// @brief Loads a character image on a loader thread.
+		/// @param[in] threadIndex Index of the loader thread.
+		/// @param[in] charCode Character unicode value.
+		/// @param[out] container The loaded character image and its metrics.
+		/// @return True if successful.
+		/// @note The FreeType objects of the loader thread are created when it loads its first character.
+		bool _tryLoadCharacterImageAsync(int threadIndex, unsigned int charCode, CharacterImageContainer& container);
+		/// @brief Gets the outline of a glyph and caches it.
+		/// @param[in] glyphIndex Index of the glyph in the face.
+		/// @return The outline or NULL if the glyph is not an outline.
+		FT_GlyphRec_* _getOutline(unsigned int glyphIndex);
+		/// @brief Gets the stroker for a border thickness and caches it.
+		/// @param[in] borderThickness Thickness of the border.
+		/// @return The stroker or NULL if it could not be created.
+		FT_StrokerRec_* _getStroker(float borderThickness);
+		/// @brief Destroys all cached strokers and outlines.
+		void _destroyBorderResources();
+		/// @brief Creates the font for a size bucket.
+		/// @param[in] bucket The bucket index.
+		/// @return The created font or NULL if it could not be created.
+		FontTtf* _createSizeBucketFont(int bucket);
+		/// @brief Destroys the font of a size bucket and removes its textures from the renderer's cache.
+		/// @param[in] font The size bucket font.
+		void _destroySizeBucketFont(FontTtf* font);
+		/// @brief Checks if the glyph index of a character was already looked up.
+		/// @param[in] charCode Character unicode value.
+		/// @return True if the glyph index of a character was already looked up.
+		bool _hasGlyphIndex(unsigned int charCode) const;
+		/// @brief Gets the glyph index of a character and caches it.
+		/// @param[in] charCode Character unicode value.
+		/// @return The glyph index or 0 if the font doesn't have the character.
+		/// @note Must only be used on the main thread.
+		unsigned int _getGlyphIndex(unsigned int charCode);
+		/// @brief Loads the glyph index of a character from a FreeType face.
+		/// @param[in] face The FreeType face.
+		/// @param[in] charCode Character unicode value.
+		/// @return The glyph index or 0 if the font doesn't have the character.
+		static unsigned int _loadGlyphIndex(FT_FaceRec_* face, unsigned int charCode);
+		/// @brief Loads the kerning value between two char codes from the font.
+		/// @param[in] previousCharCode Character unicode value of the preceding character.
+		/// @param[in] charCode Character unicode value.
+		/// @return The kerning value.
+		float _loadKerning(unsigned int previousCharCode, unsigned int charCode);
 		/// @brief Loads a border character image.
 		/// @param[in] charCode Character unicode value.
 		/// @param[in] borderThickness Thickness of the border.
 		/// @return The loaded image.
 		april::Image* _loadBorderCharacterImage(unsigned int charCode, float borderThickness);
+		/// @brief Destroys all border symbols and textures of a border thickness and its stroker.
+		/// @param[in] borderThicknessId The border thickness ID.
+		void _evictBorderThickness(int borderThicknessId);
 
 	};
 
@@ -6,12 +6,15 @@
 /// This program is free software; you can redistribute it and/or modify it under
 /// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
 
+#include <math.h>
+
 #include <ft2build.h>
 #include FT_FREETYPE_H
 #include FT_STROKER_H
 
 #include <april/RenderSystem.h>
 #include <april/Texture.h>
+#include <atres/Renderer.h>
 #include <hltypes/hfile.h>
 #include <hltypes/hlog.h>
 #include <hltypes/hltypesUtil.h>
@@ -25,6 +28,17 @@
 
 #define UNICODE_CHAR_SPACE 0x20
 #define UNICODE_CHAR_NON_BREAKING_SPACE 0xA0
+// covers Latin-1
+#define KERNING_TABLE_SIZE 256
+#define KERNING_UNKNOWN 1.0e30f
+// covers the Basic Multilingual Plane
+#define GLYPH_INDEX_PAGE_SIZE 256
+#define GLYPH_INDEX_PAGE_COUNT 256
+#define GLYPH_INDEX_UNKNOWN 0xFFFFFFFF
+
+// size buckets range from 1/8 to 8 times the base size
+#define SIZE_BUCKET_MAX 6
+#define SIZE_BUCKET_MIN_HEIGHT 4.0f
 
 #define FLOAT2PTLONG(value) (long)((value) * 64)
 #define FLOAT2PTSIZE(value) (int)((value) * 64)
@@ -37,6 +51,13 @@ namespace atresttf
 	{
 		this->customDescender = false;
 		this->loadBasicAscii = loadBasicAscii;
+		this->fontBlob = NULL;
+		this->kerningSupported = false;
+		this->kerningTable = NULL;
+		this->glyphIndexPages = NULL;
+		this->sizeBuckets = false;
+		this->sizeBucketReleaseFrames = 300;
+		this->sizeBucketLastUsedFrame = 0;
 		hstr path = hrdir::baseDir(filename);
 		harray<hstr> lines = hresource::hread(filename).split("\n", -1, true);
 		hstr line;
@@ -62,6 +83,13 @@ namespace atresttf
 	{
 		this->customDescender = false;
 		this->loadBasicAscii = loadBasicAscii;
+		this->fontBlob = NULL;
+		this->kerningSupported = false;
+		this->kerningTable = NULL;
+		this->glyphIndexPages = NULL;
+		this->sizeBuckets = false;
+		this->sizeBucketReleaseFrames = 300;
+		this->sizeBucketLastUsedFrame = 0;
 		hstr path = hrdir::baseDir(filename);
 		harray<hstr> lines = hresource::hread(filename).split("\n", -1, true);
 		hstr line;
@@ -169,19 +197,247 @@ namespace atresttf
 		this->loadBasicAscii = loadBasicAscii;
 		this->textureSize = textureSize;
 		this->customDescender = false;
+		this->fontBlob = NULL;
+		this->kerningSupported = false;
+		this->kerningTable = NULL;
+		this->glyphIndexPages = NULL;
+		this->sizeBuckets = false;
+		this->sizeBucketReleaseFrames = 300;
+		this->sizeBucketLastUsedFrame = 0;
 	}
 
 	FontTtf::~FontTtf()
 	{
+		foreach_map (int, FontTtf*, it, this->sizeBucketFonts)
+		{
+			this->_destroySizeBucketFont(it->second);
+		}
+		this->sizeBucketFonts.clear();
+		this->_stopAsyncLoading(); // the loader threads use the FreeType objects below
+		this->_destroyAsyncFaces(0);
+		this->_destroyBorderResources();
 		if (this->loaded)
 		{
 			atresttf::destroyFace(this);
 		}
+		this->_clearFontData(); // the faces use this data so it has to be released after them
+		if (this->kerningTable != NULL)
+		{
+			delete[] this->kerningTable;
+		}
+		if (this->glyphIndexPages != NULL)
+		{
+			for_iter (i, 0, GLYPH_INDEX_PAGE_COUNT)
+			{
+				if (this->glyphIndexPages[i] != NULL)
+				{
+					delete[] this->glyphIndexPages[i];
+				}
+			}
+			delete[] this->glyphIndexPages;
+		}
+	}
+
+	void FontTtf::setSizeBuckets(bool value)
+	{
+		if (this->sizeBuckets == value)
+		{
+			return;
+		}
+		this->sizeBuckets = value;
+		if (!this->sizeBuckets)
+		{
+			foreach_map (int, FontTtf*, it, this->sizeBucketFonts)
+			{
+				this->_destroySizeBucketFont(it->second);
+			}
+			this->sizeBucketFonts.clear();
+			Font::_updateTextureUsageTracking();
+		}
+	}
+
+	atres::Font* FontTtf::getScaledFont(float scale)
+	{
+		if (!this->sizeBuckets || !this->loaded || scale <= 0.0f)
+		{
+			return FontDynamic::getScaledFont(scale);
+		}
+		int bucket = hclamp(hround(log(scale) / log(2.0) * 2.0), -SIZE_BUCKET_MAX, SIZE_BUCKET_MAX);
+		if (bucket == 0)
+		{
+			return FontDynamic::getScaledFont(scale);
+		}
+		FontTtf* font = this->sizeBucketFonts.tryGet(bucket, NULL);
+		if (font == NULL)
+		{
+			font = this->_createSizeBucketFont(bucket);
+			if (font == NULL)
+			{
+				return FontDynamic::getScaledFont(scale);
+			}
+			this->sizeBucketFonts[bucket] = font;
+			Font::_updateTextureUsageTracking();
+		}
+		// the bucket's base scale already compensates its bigger or smaller size
+		font->scale = scale;
+		font->sizeBucketLastUsedFrame = Font::_getCurrentFrame();
+		return font;
+	}
+
+	FontTtf* FontTtf::_createSizeBucketFont(int bucket)
+	{
+		float factor = (float)pow(2.0, bucket * 0.5);
+		if (this->height * factor < SIZE_BUCKET_MIN_HEIGHT)
+		{
+			return NULL;
+		}
+		// all metrics are scaled so the bucket renders with exactly the same size as the base font
+		FontTtf* font = NULL;
+		if (this->fontFilename != "")
+		{
+			font = new FontTtf(this->fontFilename, this->name, this->height * factor, this->baseScale / factor, this->lineHeight * factor, this->descender * factor,
+				this->strikeThroughOffset * factor, this->underlineOffset * factor, this->italicSkewRatio, false, this->textureSize);
+		}
+		else
+		{
+			this->fontStream.rewind();
+			font = new FontTtf(this->fontStream, this->name, this->height * factor, this->baseScale / factor, this->lineHeight * factor, this->descender * factor,
+				this->strikeThroughOffset * factor, this->underlineOffset * factor, this->italicSkewRatio, false, this->textureSize);
+		}
+		font->setBorderMode(this->borderMode);
+		font->setFastDilation(this->fastDilation);
+		font->setMaxTextureCount(this->maxTextureCount);
+		font->setMaxBorderThicknessCount(this->maxBorderThicknessCount);
+		font->setMinTextureSize(this->minTextureSize);
+		font->setAtlasPool(this->atlasPool);
+		font->setChannelPacking(this->channelPacking);
+		if (!font->load())
+		{
+			hlog::errorf(logTag, "Could not create size bucket %d for font '%s'.", bucket, this->name.cStr());
+			delete font;
+			return NULL;
+		}
+		font->setLoaderThreadCount(this->loaderThreadCount);
+		font->setAsyncLoading(this->asyncLoading);
+		hlog::debugf(logTag, "Font '%s': created size bucket %d with height %g.", this->name.cStr(), bucket, this->height * factor);
+		return font;
+	}
+
+	void FontTtf::_destroySizeBucketFont(FontTtf* font)
+	{
+		if (atres::renderer != NULL)
+		{
+			harray<april::Texture*> textures = font->getTextures();
+			foreach (april::Texture*, it, textures)
+			{
+				atres::renderer->clearCache(*it);
+			}
+		}
+		delete font;
+	}
+
+	int FontTtf::uploadTextures()
+	{
+		int result = FontDynamic::uploadTextures();
+		if (this->sizeBucketFonts.size() > 0)
+		{
+			int frame = Font::_getCurrentFrame();
+			harray<int> unusedBuckets;
+			foreach_map (int, FontTtf*, it, this->sizeBucketFonts)
+			{
+				if (frame - it->second->sizeBucketLastUsedFrame > this->sizeBucketReleaseFrames)
+				{
+					unusedBuckets += it->first;
+				}
+				else
+				{
+					result += it->second->uploadTextures();
+				}
+			}
+			foreach (int, it, unusedBuckets)
+			{
+				hlog::debugf(logTag, "Font '%s': destroying unused size bucket %d.", this->name.cStr(), (*it));
+				this->_destroySizeBucketFont(this->sizeBucketFonts[*it]);
+				this->sizeBucketFonts.removeKey(*it);
+			}
+			if (unusedBuckets.size() > 0)
+			{
+				Font::_updateTextureUsageTracking();
+			}
+		}
+		return result;
+	}
+
+	bool FontTtf::markTextureUsed(april::Texture* texture)
+	{
+		if (FontDynamic::markTextureUsed(texture))
+		{
+			return true;
+		}
+		foreach_map (int, FontTtf*, it, this->sizeBucketFonts)
+		{
+			if (it->second->markTextureUsed(texture))
+			{
+				it->second->sizeBucketLastUsedFrame = Font::_getCurrentFrame();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool FontTtf::findWhiteTexel(april::Texture* texture, gvec2f& uv) const
+	{
+		if (FontDynamic::findWhiteTexel(texture, uv))
+		{
+			return true;
+		}
+		harray<FontTtf*> fonts = this->sizeBucketFonts.values();
+		foreach (FontTtf*, it, fonts)
+		{
+			if ((*it)->findWhiteTexel(texture, uv))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	april::Texture* FontTtf::getChannelTexture(april::Texture* texture, int channel)
+	{
+		april::Texture* result = FontDynamic::getChannelTexture(texture, channel);
+		if (result != NULL)
+		{
+			return result;
+		}
+		harray<FontTtf*> fonts = this->sizeBucketFonts.values();
+		foreach (FontTtf*, it, fonts)
+		{
+			result = (*it)->getChannelTexture(texture, channel);
+			if (result != NULL)
+			{
+				return result;
+			}
+		}
+		return NULL;
+	}
+
+	bool FontTtf::isTextureUsageTracked() const
+	{
+		// size buckets are destroyed when they weren't used for a while
+		return (this->sizeBucketFonts.size() > 0 || FontDynamic::isTextureUsageTracked());
 	}
 
 	void FontTtf::setBorderMode(const BorderMode& value)
 	{
+		if (this->borderMode != value)
+		{
+			this->_destroyBorderResources();
+		}
 		this->_setBorderMode(value);
+		foreach_map (int, FontTtf*, it, this->sizeBucketFonts)
+		{
+			it->second->setBorderMode(value);
+		}
 	}
 
 	bool FontTtf::_load()
@@ -207,54 +463,26 @@ namespace atresttf
 			this->lineHeight = this->height;
 		}
 		// libfreetype stuff
-		if (this->fontStream.size() == 0)
+		if (this->fontStream.size() == 0 && this->fontBlob == NULL)
 		{
-			this->fontStream.clear();
-			if (hresource::exists(this->fontFilename)) // prefer local fonts
+			// fonts using the same file share its data
+			this->fontBlob = atresttf::acquireFontBlob(this->fontFilename);
+			if (this->fontBlob == NULL)
 			{
-				hresource file;
-				file.open(this->fontFilename);
-				this->fontStream.writeRaw(file);
-			}
-			else
-			{
-				hfile file;
-				file.open(this->fontFilename);
-				this->fontStream.writeRaw(file);
+				return false;
 			}
 		}
-		FT_Library library = atresttf::getLibrary();
-		FT_Face face = NULL;
-		FT_Error error = FT_New_Memory_Face(library, (unsigned char*)this->fontStream, (FT_Long)this->fontStream.size(), 0, &face);
-		if (error == FT_Err_Unknown_File_Format)
-		{
-			hlog::error(logTag, "Format not supported in: " + this->fontFilename);
-			this->fontStream.clear();
-			return false;
-		}
-		if (error != 0)
-		{
-			hlog::error(logTag, "Could not read face 0 in: " + this->fontFilename + "; Error code: " + hstr(error));
-			this->fontStream.clear();
-			return false;
-		}
-		FT_Size_RequestRec request;
-		memset(&request, 0, sizeof(FT_Size_RequestRec));
-		request.height = FLOAT2PTLONG(hround((double)this->height));
-		request.type = FT_SIZE_REQUEST_TYPE_REAL_DIM;
-		error = FT_Request_Size(face, &request);
-		if (error != 0)
+		FT_Face face = this->_createFace(atresttf::getLibrary());
+		if (face == NULL)
 		{
-			hlog::error(logTag, "Could not set font size in: " + this->fontFilename);
-			this->fontStream.clear();
-			FT_Done_Face(face);
+			this->_clearFontData();
 			return false;
 		}
 		if (!atres::FontDynamic::_load())
 		{
 			hlog::error(logTag, "Could not load base class in: " + this->fontFilename);
-			this->fontStream.clear();
 			FT_Done_Face(face);
+			this->_clearFontData();
 			return false;
 		}
 		this->internalDescender = -PTSIZE2FLOAT(face->size->metrics.descender);
@@ -262,6 +490,7 @@ namespace atresttf
 		{
 			this->descender = this->internalDescender;
 		}
+		this->kerningSupported = FT_HAS_KERNING(face);
 		atresttf::registerFace(this, face);
 		// adding all base ASCII characters right away
 		if (this->loadBasicAscii)
@@ -271,29 +500,92 @@ namespace atresttf
 		return true;
 	}
 
-	april::Image* FontTtf::_loadCharacterImage(unsigned int charCode, bool initial, float& advance, int& leftOffset, int& topOffset, float& ascender, float& descender, float& bearingX)
+	void FontTtf::_clearFontData()
 	{
-		FT_Face face = atresttf::getFace(this);
-		unsigned long charIndex = charCode;
-		if (charIndex == UNICODE_CHAR_NON_BREAKING_SPACE) // non-breaking space character should be treated just like a normal space when retrieving the glyph from the font
+		this->fontStream.clear();
+		if (this->fontBlob != NULL)
 		{
-			charIndex = UNICODE_CHAR_SPACE;
+			atresttf::releaseFontBlob(this->fontBlob);
+			this->fontBlob = NULL;
 		}
-		unsigned int glyphIndex = FT_Get_Char_Index(face, charIndex);
+	}
+
+	FT_Face FontTtf::_createFace(FT_Library library)
+	{
+		FT_Face face = NULL;
+		FT_Error error = 0;
+		if (this->fontBlob != NULL)
+		{
+			error = FT_New_Memory_Face(library, this->fontBlob->data, (FT_Long)this->fontBlob->size, 0, &face);
+		}
+		else
+		{
+			error = FT_New_Memory_Face(library, (unsigned char*)this->fontStream, (FT_Long)this->fontStream.size(), 0, &face);
+		}
+		if (error == FT_Err_Unknown_File_Format)
+		{
+			hlog::error(logTag, "Format not supported in: " + this->fontFilename);
+			return NULL;
+		}
+		if (error != 0)
+		{
+			hlog::error(logTag, "Could not read face 0 in: " + this->fontFilename + "; Error code: " + hstr(error));
+			return NULL;
+		}
+		FT_Size_RequestRec request;
+		memset(&request, 0, sizeof(FT_Size_RequestRec));
+		request.height = FLOAT2PTLONG(hround((double)this->height));
+		request.type = FT_SIZE_REQUEST_TYPE_REAL_DIM;
+		error = FT_Request_Size(face, &request);
+		if (error != 0)
+		{
+			hlog::error(logTag, "Could not set font size in: " + this->fontFilename);
+			FT_Done_Face(face);
+			return NULL;
+		}
+		return face;
+	}
+
+	bool FontTtf::_isAsyncLoadingSupported() const
+	{
+		return true;
+	}
+
+	april::Image* FontTtf::_loadCharacterImage(unsigned int charCode, bool initial, float& advance, int& leftOffset, int& topOffset, float& ascender, float& descender, float& bearingX)
+	{
+		bool known = this->_hasGlyphIndex(charCode);
+		unsigned int glyphIndex = this->_getGlyphIndex(charCode);
 		if (glyphIndex == 0)
 		{
-			if (!initial && charCode >= UNICODE_CHAR_SPACE)
+			if (!known && !initial && charCode >= UNICODE_CHAR_SPACE) // logged only once
 			{
 				hlog::debugf(logTag, "Character '0x%X' does not exist in: %s", charCode, this->fontFilename.cStr());
 			}
 			return NULL;
 		}
+		// once native borders are used, the outline is kept so the glyph doesn't have to be loaded again for its border
+		FT_Glyph outline = NULL;
+		bool keepOutline = (this->borderMode == BorderMode::FontNative && this->getBorderThicknessCount() > 0 && !this->outlines.hasKey(glyphIndex));
+		april::Image* image = this->_loadCharacterImage(atresttf::getFace(this), glyphIndex, advance, leftOffset, topOffset, ascender, descender, bearingX, (keepOutline ? &outline : NULL));
+		if (outline != NULL)
+		{
+			this->outlines[glyphIndex] = outline;
+		}
+		return image;
+	}
+
+	april::Image* FontTtf::_loadCharacterImage(FT_Face face, unsigned int glyphIndex, float& advance, int& leftOffset, int& topOffset, float& ascender, float& descender, float& bearingX, FT_Glyph* outline)
+	{
 		FT_Error error = FT_Load_Glyph(face, glyphIndex, FT_LOAD_DEFAULT);
 		if (error != 0)
 		{
 			hlog::error(logTag, "Could not load glyph from: " + this->fontFilename);
 			return NULL;
 		}
+		if (outline != NULL && face->glyph->format == FT_GLYPH_FORMAT_OUTLINE && FT_Get_Glyph(face->glyph, outline) != 0)
+		{
+			(*outline) = NULL;
+		}
 		if (face->glyph->format != FT_GLYPH_FORMAT_BITMAP)
 		{
 			error = FT_Render_Glyph(face->glyph, FT_RENDER_MODE_LIGHT);
@@ -312,52 +604,115 @@ namespace atresttf
 		return april::Image::create(face->glyph->bitmap.width, face->glyph->bitmap.rows, face->glyph->bitmap.buffer, april::Image::Format::Alpha);
 	}
 
-	april::Image* FontTtf::_loadBorderCharacterImage(unsigned int charCode, float borderThickness)
+	bool FontTtf::_loadCharacterMetrics(unsigned int charCode, CharacterImageContainer& container, int& imageWidth, int& imageHeight)
 	{
 		FT_Face face = atresttf::getFace(this);
-		unsigned long charIndex = charCode;
-		if (charIndex == UNICODE_CHAR_NON_BREAKING_SPACE) // non-breaking space character should be treated just like a normal space when retrieving the glyph from the font
+		unsigned int glyphIndex = this->_getGlyphIndex(charCode);
+		if (glyphIndex == 0 || FT_Load_Glyph(face, glyphIndex, FT_LOAD_DEFAULT) != 0 || face->glyph->format != FT_GLYPH_FORMAT_OUTLINE)
 		{
-			charIndex = UNICODE_CHAR_SPACE;
+			return false;
 		}
-		unsigned int glyphIndex = FT_Get_Char_Index(face, charIndex);
-		if (glyphIndex == 0)
+		// same bitmap bounds that rendering the outline would create
+		FT_Glyph_Metrics& metrics = face->glyph->metrics;
+		container.charCode = charCode;
+		container.advance = PTSIZE2FLOAT(face->glyph->advance.x);
+		container.leftOffset = hfloor(PTSIZE2FLOAT(metrics.horiBearingX));
+		container.topOffset = hceil(PTSIZE2FLOAT(metrics.horiBearingY));
+		container.ascender = -PTSIZE2FLOAT(face->size->metrics.ascender);
+		container.descender = -PTSIZE2FLOAT(face->size->metrics.descender);
+		container.bearingX = PTSIZE2FLOAT(metrics.horiBearingX);
+		imageWidth = hceil(PTSIZE2FLOAT(metrics.horiBearingX + metrics.width)) - container.leftOffset;
+		imageHeight = container.topOffset - hfloor(PTSIZE2FLOAT(metrics.horiBearingY - metrics.height));
+		return true;
+	}
+
+	void FontTtf::_prepareAsyncLoading(int threadCount)
+	{
+		this->_destroyAsyncFaces(threadCount);
+		while (this->asyncFaces.size() < threadCount)
+		{
+			this->asyncLibraries += (FT_Library)NULL;
+			this->asyncFaces += (FT_Face)NULL;
+		}
+	}
+
+	void FontTtf::_destroyAsyncFaces(int threadCount)
+	{
+		while (this->asyncFaces.size() > threadCount)
 		{
-			if (charCode >= UNICODE_CHAR_SPACE)
+			FT_Face face = this->asyncFaces.removeLast();
+			FT_Library library = this->asyncLibraries.removeLast();
+			if (face != NULL)
 			{
-				hlog::debugf(logTag, "Border character '0x%X' does not exist in: %s", charCode, this->fontFilename.cStr());
+				FT_Done_Face(face);
+			}
+			if (library != NULL)
+			{
+				FT_Done_FreeType(library);
 			}
-			return NULL;
 		}
-		FT_Error error = FT_Load_Glyph(face, glyphIndex, FT_LOAD_DEFAULT);
-		if (error != 0)
+	}
+
+	bool FontTtf::_tryLoadCharacterImageAsync(int threadIndex, unsigned int charCode, CharacterImageContainer& container)
+	{
+		// each thread only accesses its own entries which don't change while the threads are running
+		FT_Face& face = this->asyncFaces[threadIndex];
+		if (face == NULL)
 		{
-			hlog::error(logTag, "Could not load glyph from: " + this->fontFilename);
+			FT_Library& library = this->asyncLibraries[threadIndex];
+			if (library == NULL && FT_Init_FreeType(&library) != 0)
+			{
+				hlog::error(logTag, "Could not initialize FreeType library for a loader thread!");
+				library = NULL;
+				return false;
+			}
+			face = this->_createFace(library);
+			if (face == NULL)
+			{
+				return false;
+			}
+		}
+		// the glyph index cache is only used on the main thread
+		unsigned int glyphIndex = FontTtf::_loadGlyphIndex(face, charCode);
+		if (glyphIndex == 0)
+		{
+			return false;
+		}
+		container.charCode = charCode;
+		container.image = this->_loadCharacterImage(face, glyphIndex, container.advance, container.leftOffset, container.topOffset, container.ascender, container.descender, container.bearingX);
+		return (container.image != NULL);
+	}
+
+	april::Image* FontTtf::_loadBorderCharacterImage(unsigned int charCode, float borderThickness)
+	{
+		bool known = this->_hasGlyphIndex(charCode);
+		unsigned int glyphIndex = this->_getGlyphIndex(charCode);
+		if (glyphIndex == 0)
+		{
+			if (!known && charCode >= UNICODE_CHAR_SPACE) // logged only once
+			{
+				hlog::debugf(logTag, "Border character '0x%X' does not exist in: %s", charCode, this->fontFilename.cStr());
+			}
 			return NULL;
 		}
-		if (face->glyph->format != FT_GLYPH_FORMAT_OUTLINE) // native border actually not supported in this font
+		FT_Glyph outline = this->_getOutline(glyphIndex);
+		if (outline == NULL)
 		{
-			hlog::error(logTag, "Not an outline glyph: " + this->fontFilename);
 			return NULL;
 		}
-		FT_Stroker stroker;
-		error = FT_Stroker_New(atresttf::getLibrary(), &stroker);
-		if (error != 0)
+		FT_Stroker stroker = this->_getStroker(borderThickness);
+		if (stroker == NULL)
 		{
-			hlog::error(logTag, "Could not create stroker: " + this->fontFilename);
 			return NULL;
 		}
-		FT_Stroker_Set(stroker, FLOAT2PTSIZE(borderThickness), FT_STROKER_LINECAP_ROUND, FT_STROKER_LINEJOIN_MITER_FIXED, 1 << 16);
-		FT_Glyph glyph;
-		error = FT_Get_Glyph(face->glyph, &glyph);
+		FT_Glyph glyph = NULL;
+		FT_Error error = FT_Glyph_Copy(outline, &glyph);
 		if (error != 0)
 		{
-			hlog::error(logTag, "Could not get glyph from: " + this->fontFilename);
-			FT_Stroker_Done(stroker);
+			hlog::error(logTag, "Could not copy glyph from: " + this->fontFilename);
 			return NULL;
 		}
 		error = FT_Glyph_StrokeBorder(&glyph, stroker, false, true);
-		FT_Stroker_Done(stroker);
 		if (error != 0)
 		{
 			hlog::error(logTag, "Could not stroke: " + this->fontFilename);
@@ -389,52 +744,192 @@ namespace atresttf
 
 	float FontTtf::getKerning(unsigned int previousCharCode, unsigned int charCode)
 	{
-		if (previousCharCode == 0 || charCode == 0)
+		if (previousCharCode == 0 || charCode == 0 || !this->kerningSupported)
 		{
 			return 0.0f;
 		}
+		if (previousCharCode < KERNING_TABLE_SIZE && charCode < KERNING_TABLE_SIZE)
+		{
+			if (this->kerningTable == NULL)
+			{
+				this->kerningTable = new float[KERNING_TABLE_SIZE * KERNING_TABLE_SIZE];
+				for_iter (i, 0, KERNING_TABLE_SIZE * KERNING_TABLE_SIZE)
+				{
+					this->kerningTable[i] = KERNING_UNKNOWN;
+				}
+			}
+			float& kerning = this->kerningTable[previousCharCode * KERNING_TABLE_SIZE + charCode];
+			if (kerning == KERNING_UNKNOWN)
+			{
+				kerning = this->_loadKerning(previousCharCode, charCode);
+			}
+			return kerning;
+		}
+		std::pair<unsigned int, unsigned int> key(previousCharCode, charCode);
+		hmap<std::pair<unsigned int, unsigned int>, float>::iterator it = this->kerningCache.find(key);
+		if (it != this->kerningCache.end())
+		{
+			return it->second;
+		}
+		float kerning = this->_loadKerning(previousCharCode, charCode);
+		this->kerningCache[key] = kerning;
+		return kerning;
+	}
+
+	FT_Glyph FontTtf::_getOutline(unsigned int glyphIndex)
+	{
+		hmap<unsigned int, FT_Glyph>::iterator it = this->outlines.find(glyphIndex);
+		if (it != this->outlines.end())
+		{
+			return it->second;
+		}
+		// failures are cached as well so they are logged only once
+		FT_Glyph outline = NULL;
 		FT_Face face = atresttf::getFace(this);
-		if (!FT_HAS_KERNING(face))
+		if (FT_Load_Glyph(face, glyphIndex, FT_LOAD_DEFAULT) != 0)
 		{
-			return 0.0f;
+			hlog::error(logTag, "Could not load glyph from: " + this->fontFilename);
+		}
+		else if (face->glyph->format != FT_GLYPH_FORMAT_OUTLINE) // native border actually not supported in this font
+		{
+			hlog::error(logTag, "Not an outline glyph: " + this->fontFilename);
+		}
+		else if (FT_Get_Glyph(face->glyph, &outline) != 0)
+		{
+			hlog::error(logTag, "Could not get glyph from: " + this->fontFilename);
+			outline = NULL;
+		}
+		this->outlines[glyphIndex] = outline;
+		return outline;
+	}
+
+	FT_Stroker FontTtf::_getStroker(float borderThickness)
+	{
+		int thicknessId = Font::makeBorderThicknessId(borderThickness);
+		hmap<int, FT_Stroker>::iterator it = this->strokers.find(thicknessId);
+		if (it != this->strokers.end())
+		{
+			return it->second;
+		}
+		FT_Stroker stroker = NULL;
+		if (FT_Stroker_New(atresttf::getLibrary(), &stroker) != 0)
+		{
+			hlog::error(logTag, "Could not create stroker: " + this->fontFilename);
+			return NULL;
+		}
+		FT_Stroker_Set(stroker, FLOAT2PTSIZE(borderThickness), FT_STROKER_LINECAP_ROUND, FT_STROKER_LINEJOIN_MITER_FIXED, 1 << 16);
+		this->strokers[thicknessId] = stroker;
+		return stroker;
+	}
+
+	void FontTtf::_evictBorderThickness(int borderThicknessId)
+	{
+		FontDynamic::_evictBorderThickness(borderThicknessId);
+		hmap<int, FT_Stroker>::iterator it = this->strokers.find(borderThicknessId);
+		if (it != this->strokers.end())
+		{
+			FT_Stroker_Done(it->second);
+			this->strokers.erase(it);
+		}
+	}
+
+	void FontTtf::_destroyBorderResources()
+	{
+		for (hmap<unsigned int, FT_Glyph>::iterator it = this->outlines.begin(); it != this->outlines.end(); ++it)
+		{
+			if (it->second != NULL)
+			{
+				FT_Done_Glyph(it->second);
+			}
+		}
+		this->outlines.clear();
+		for (hmap<int, FT_Stroker>::iterator it = this->strokers.begin(); it != this->strokers.end(); ++it)
+		{
+			FT_Stroker_Done(it->second);
+		}
+		this->strokers.clear();
+	}
+
+	bool FontTtf::_hasGlyphIndex(unsigned int charCode) const
+	{
+		if (charCode < GLYPH_INDEX_PAGE_SIZE * GLYPH_INDEX_PAGE_COUNT)
+		{
+			if (this->glyphIndexPages == NULL)
+			{
+				return false;
+			}
+			const unsigned int* page = this->glyphIndexPages[charCode / GLYPH_INDEX_PAGE_SIZE];
+			return (page != NULL && page[charCode % GLYPH_INDEX_PAGE_SIZE] != GLYPH_INDEX_UNKNOWN);
+		}
+		return this->sparseGlyphIndices.hasKey(charCode);
+	}
+
+	unsigned int FontTtf::_getGlyphIndex(unsigned int charCode)
+	{
+		if (charCode < GLYPH_INDEX_PAGE_SIZE * GLYPH_INDEX_PAGE_COUNT)
+		{
+			if (this->glyphIndexPages == NULL)
+			{
+				this->glyphIndexPages = new unsigned int*[GLYPH_INDEX_PAGE_COUNT];
+				memset(this->glyphIndexPages, 0, GLYPH_INDEX_PAGE_COUNT * sizeof(unsigned int*));
+			}
+			unsigned int*& page = this->glyphIndexPages[charCode / GLYPH_INDEX_PAGE_SIZE];
+			if (page == NULL)
+			{
+				page = new unsigned int[GLYPH_INDEX_PAGE_SIZE];
+				for_iter (i, 0, GLYPH_INDEX_PAGE_SIZE)
+				{
+					page[i] = GLYPH_INDEX_UNKNOWN;
+				}
+			}
+			unsigned int& glyphIndex = page[charCode % GLYPH_INDEX_PAGE_SIZE];
+			if (glyphIndex == GLYPH_INDEX_UNKNOWN)
+			{
+				glyphIndex = FontTtf::_loadGlyphIndex(atresttf::getFace(this), charCode);
+			}
+			return glyphIndex;
 		}
-		std::pair<unsigned int, unsigned int> key;
-		if (this->kerningCache.hasKey(key))
+		hmap<unsigned int, unsigned int>::iterator it = this->sparseGlyphIndices.find(charCode);
+		if (it != this->sparseGlyphIndices.end())
 		{
-			return this->kerningCache[key];
+			return it->second;
 		}
+		unsigned int glyphIndex = FontTtf::_loadGlyphIndex(atresttf::getFace(this), charCode);
+		this->sparseGlyphIndices[charCode] = glyphIndex;
+		return glyphIndex;
+	}
+
+	unsigned int FontTtf::_loadGlyphIndex(FT_Face face, unsigned int charCode)
+	{
 		unsigned long charIndex = charCode;
 		if (charIndex == UNICODE_CHAR_NON_BREAKING_SPACE) // non-breaking space character should be treated just like a normal space when retrieving the glyph from the font
 		{
 			charIndex = UNICODE_CHAR_SPACE;
 		}
 		unsigned int glyphIndex = FT_Get_Char_Index(face, charIndex);
+		return glyphIndex;
+	}
+
+	float FontTtf::_loadKerning(unsigned int previousCharCode, unsigned int charCode)
+	{
+		unsigned int glyphIndex = this->_getGlyphIndex(charCode);
 		if (glyphIndex == 0)
 		{
-			this->kerningCache[key] = 0.0f;
-			return this->kerningCache[key];
-		}
-		unsigned long previousCharInex = previousCharCode;
-		if (previousCharInex == UNICODE_CHAR_NON_BREAKING_SPACE) // non-breaking space character should be treated just like a normal space when retrieving the glyph from the font
-		{
-			previousCharInex = UNICODE_CHAR_SPACE;
+			return 0.0f;
 		}
-		unsigned int previousGlyphIndex = FT_Get_Char_Index(face, previousCharInex);
+		unsigned int previousGlyphIndex = this->_getGlyphIndex(previousCharCode);
 		if (previousGlyphIndex == 0)
 		{
-			this->kerningCache[key] = 0.0f;
-			return this->kerningCache[key];
+			return 0.0f;
 		}
 		FT_Vector kerningVector;
-		FT_Error error = FT_Get_Kerning(face, previousGlyphIndex, glyphIndex, FT_KERNING_DEFAULT, &kerningVector);
+		FT_Error error = FT_Get_Kerning(atresttf::getFace(this), previousGlyphIndex, glyphIndex, FT_KERNING_DEFAULT, &kerningVector);
 		if (error != 0)
 		{
 			hlog::errorf(logTag, "Could not get kerning for pair 0x%2X,0x%2X, error: 0x%2X", previousGlyphIndex, glyphIndex, error);
-			this->kerningCache[key] = 0.0f;
-			return this->kerningCache[key];
+			return 0.0f;
 		}
-		this->kerningCache[key] = PTSIZE2FLOAT(kerningVector.x);
-		return this->kerningCache[key];
+		return PTSIZE2FLOAT(kerningVector.x);
 	}
 
 }
@@ -11,6 +11,12 @@
 #ifdef __APPLE__
 #include <TargetConditionals.h>
 #endif
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #define __HL_INCLUDE_PLATFORM_HEADERS
 #include <april/Window.h>
@@ -19,9 +25,11 @@
 #include <hltypes/harray.h>
 #include <hltypes/hdir.h>
 #include <hltypes/hexception.h>
+#include <hltypes/hfile.h>
 #include <hltypes/hlog.h>
 #include <hltypes/hmap.h>
 #include <hltypes/hplatform.h>
+#include <hltypes/hresource.h>
 #include <hltypes/hstring.h>
 #include <hltypes/hversion.h>
 
@@ -36,6 +44,7 @@ namespace atresttf
 
 	FT_Library library = NULL;
 	hmap<atres::Font*, FT_Face> faces;
+	hmap<hstr, FontBlob*> fontBlobs;
 	static hmap<hstr, hstr> fonts;
 	static bool fontNamesChecked = false;
 
@@ -203,4 +212,139 @@ namespace atresttf
 		faces.removeKey(font);
 	}
 
+	FontBlob::FontBlob(chstr filename) :
+		data(NULL),
+		size(0),
+		references(0),
+		mapped(false)
+	{
+		this->filename = filename;
+	}
+
+	FontBlob::~FontBlob()
+	{
+		if (this->data == NULL)
+		{
+			return;
+		}
+		if (!this->mapped)
+		{
+			delete[] this->data;
+			return;
+		}
+#ifdef _WIN32
+#ifndef _WINRT
+		UnmapViewOfFile(this->data);
+#endif
+#else
+		munmap(this->data, (size_t)this->size);
+#endif
+	}
+
+	bool FontBlob::map()
+	{
+#ifdef _WIN32
+#ifndef _WINRT
+		HANDLE file = CreateFileW(this->filename.wStr().c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+		{
+			return false;
+		}
+		LARGE_INTEGER fileSize;
+		if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+		{
+			CloseHandle(file);
+			return false;
+		}
+		HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		CloseHandle(file); // the mapping keeps the file open
+		if (mapping == NULL)
+		{
+			return false;
+		}
+		void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		CloseHandle(mapping); // the view keeps the mapping open
+		if (data == NULL)
+		{
+			return false;
+		}
+		this->data = (unsigned char*)data;
+		this->size = (int64_t)fileSize.QuadPart;
+		this->mapped = true;
+		return true;
+#else
+		return false;
+#endif
+#else
+		int file = open(this->filename.cStr(), O_RDONLY);
+		if (file < 0)
+		{
+			return false;
+		}
+		struct stat info;
+		if (fstat(file, &info) != 0 || info.st_size == 0)
+		{
+			close(file);
+			return false;
+		}
+		void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		close(file); // the mapping keeps the file open
+		if (data == MAP_FAILED)
+		{
+			return false;
+		}
+		this->data = (unsigned char*)data;
+		this->size = (int64_t)info.st_size;
+		this->mapped = true;
+		return true;
+#endif
+	}
+
+	FontBlob* acquireFontBlob(chstr filename)
+	{
+		FontBlob* blob = fontBlobs.tryGet(filename, NULL);
+		if (blob != NULL)
+		{
+			++blob->references;
+			return blob;
+		}
+		blob = new FontBlob(filename);
+		if (hresource::exists(filename)) // prefer local fonts, resources can be inside of archives so they are not mapped
+		{
+			hresource file;
+			file.open(filename);
+			blob->size = file.size();
+			blob->data = new unsigned char[(size_t)blob->size];
+			file.readRaw(blob->data, blob->size);
+		}
+		else if (!blob->map())
+		{
+			hfile file;
+			file.open(filename);
+			blob->size = file.size();
+			blob->data = new unsigned char[(size_t)blob->size];
+			file.readRaw(blob->data, blob->size);
+		}
+		if (blob->size == 0)
+		{
+			hlog::error(logTag, "Could not read: " + filename);
+			delete blob;
+			return NULL;
+		}
+		hlog::debugf(logTag, "Loaded font file '%s' (%s).", filename.cStr(), blob->mapped ? "mapped" : "in memory");
+		blob->references = 1;
+		fontBlobs[filename] = blob;
+		return blob;
+	}
+
+	void releaseFontBlob(FontBlob* blob)
+	{
+		--blob->references;
+		if (blob->references <= 0)
+		{
+			fontBlobs.removeKey(blob->filename);
+			delete blob;
+		}
+	}
+
 }
@@ -17,6 +17,7 @@
 #include FT_FREETYPE_H
 
 #include <hltypes/hmap.h>
+#include <hltypes/hstring.h>
 
 namespace atres
 {
@@ -25,13 +26,49 @@ namespace atres
 
 namespace atresttf
 {
+	/// @brief Font file data shared by all fonts that use the same file.
+	class FontBlob
+	{
+	public:
+		/// @brief Filename of the font file.
+		hstr filename;
+		/// @brief The font file data.
+		unsigned char* data;
+		/// @brief Size of the font file data.
+		int64_t size;
+		/// @brief Number of fonts that use the data.
+		int references;
+		/// @brief Whether the data is memory-mapped instead of allocated.
+		bool mapped;
+
+		/// @brief Basic constructor.
+		/// @param[in] filename Filename of the font file.
+		FontBlob(chstr filename);
+		/// @brief Destructor.
+		~FontBlob();
+
+		/// @brief Memory-maps the font file.
+		/// @return True if successful.
+		bool map();
+
+	};
+
 	FT_Library getLibrary();
 	FT_Face getFace(atres::Font* font);
 	void registerFace(atres::Font* font, FT_Face face);
 	void destroyFace(atres::Font* font);
+	/// @brief Gets the shared data of a font file and loads it if necessary.
+	/// @param[in] filename Filename of the font file.
+	/// @return The shared font file data or NULL if the file could not be read.
+	/// @note Every call must be matched with a call to releaseFontBlob().
+	FontBlob* acquireFontBlob(chstr filename);
+	/// @brief Releases the shared data of a font file and destroys it when it isn't used anymore.
+	/// @param[in] blob The shared font file data.
+	void releaseFontBlob(FontBlob* blob);
 
 	extern FT_Library library;
 	extern hmap<atres::Font*, FT_Face> faces;
+	extern hmap<hstr, FontBlob*> fontBlobs;
 
 };
 
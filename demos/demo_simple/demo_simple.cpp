@@ -34,6 +34,7 @@
 #include <april/Window.h>
 #include <atres/atres.h>
 #include <atres/FontBitmap.h>
+#include <atres/FontDynamic.h>
 #include <atres/FontIconMap.h>
 #include <atres/Renderer.h>
 #include <atresttf/atresttf.h>
@@ -41,6 +42,7 @@
 #include <gtypes/Rectangle.h>
 #include <hltypes/hlog.h>
 #include <hltypes/hltypesUtil.h>
+#include <hltypes/hresource.h>
 #include <hltypes/hstring.h>
 
 #ifdef __APPLE__
@@ -59,6 +61,24 @@
 #define TEXT_5 "[b:,3]This is a vertical test.\nIt really is. Really."
 #define TEXT_6 "This is [c:FFFF00][t:FF0000]a [b=007FFF,2]strike-[i:icon_font]blue[/i]-[c:00FF00]through[/c]\ntest[/b][/t] [t]an[/t][/c][t]d[/t] " \
 	"this[u:,4]\nis an [s=007FFF,2,2]under[c:FF0000]line[/c]\nte[/s]st[/u]."
+#define TEXT_BORDER_BENCHMARK "[b=000000,1]The quick brown fox[/b] [b=FF0000,2.5]jumps over[/b] [b=007FFF,4]the lazy dog[/b] " \
+	"[b=00FF00,1.5]and [i:icon_font]neon[/i] keeps[/b] [b]jumping[/b] [b=FFFF00,1]until the end of the text.[/b]"
+#define TEXT_LATIN_BENCHMARK "AVAST! Two vowels, a Tawny fox, WAVY yellow Lines and TOYS. " "\xC3\x9C" "ber das Wasser f" "\xC3\xA4" "hrt Yves w" "\xC3\xA4" "hrend Th" "\xC3\xA9" "o " "\xC3\xA0" " l'h" "\xC3\xB4" "tel attend. " \
+	"Avoid typing \"LT\", \"Ty\", \"Wo\" or \"Yo\" pairs without kerning, Vera. Fjord quays are a wavy, lovely view to every traveller."
+
+#define BENCHMARK_ITERATIONS 1000
+#define ATLAS_BENCHMARK_FIRST_CHAR 0x21 // Basic Latin up to Latin Extended-B
+#define ATLAS_BENCHMARK_LAST_CHAR 0x24F
+#define ATLAS_BENCHMARK_FONT_SIZE 48.0f
+#define PACKER_BENCHMARK_CHARACTER_SPACE 2 // spacing that both packers reserve around every symbol
+#define PREWARM_BENCHMARK_THREAD_COUNT 4
+#define BORDER_BENCHMARK_THICKNESS_COUNT 4
+#define DILATION_BENCHMARK_ITERATIONS 100
+#define DILATION_BENCHMARK_SYMBOL_SIZE 64
+#define DILATION_BENCHMARK_MAX_THICKNESS 8
+#define DISTANCE_FIELD_CHECK_SPREAD 6
+#define DISTANCE_FIELD_CHECK_RADIUS 14.5f
+#define DISTANCE_FIELD_CHECK_MAX_ERROR 8 // in 1/255 of coverage
 
 grectf drawRect(0.0f, 0.0f, 800.0f, 600.0f);
 grectf viewport(0.0f, 0.0f, 1024.0f, 768.0f);
@@ -71,6 +91,432 @@ grectf textArea5(700.0f, 600.0f, 240.0f, 76.0f);
 grectf textArea6(60.0f, 200.0f, 400.0f, 160.0f);
 april::Color backgroundColor = april::Color(0, 0, 0, 128);
 
+void benchmarkLayout(chstr title, chstr fontName, cgrectf rect, chstr text)
+{
+	harray<atres::FormatTag> tags;
+	hstr unformattedText = atres::renderer->analyzeFormatting(text, tags);
+	atres::FormatTag tag;
+	tag.type = atres::FormatTag::Type::Color;
+	tag.data = april::Color::White.hex();
+	tags.addFirst(tag);
+	tag.type = atres::FormatTag::Type::Font;
+	tag.data = fontName;
+	tags.addFirst(tag);
+	// first pass loads all symbols so only the layout itself is measured
+	harray<atres::RenderLine> lines = atres::renderer->createRenderLines(rect, unformattedText, tags, atres::Horizontal::CenterWrapped, atres::Vertical::Center);
+	atres::RenderText renderText = atres::renderer->createRenderText(rect, text, lines, tags);
+	int64_t start = htickCount();
+	for_iter (i, 0, BENCHMARK_ITERATIONS)
+	{
+		lines = atres::renderer->createRenderLines(rect, unformattedText, tags, atres::Horizontal::CenterWrapped, atres::Vertical::Center);
+		renderText = atres::renderer->createRenderText(rect, text, lines, tags);
+	}
+	hlog::writef(LOG_TAG, "%s: %.4f ms per layout (%d iterations)", title.cStr(), (float)(htickCount() - start) / BENCHMARK_ITERATIONS, BENCHMARK_ITERATIONS);
+}
+
+void benchmarkDilation(const atres::Font::BorderMode& borderMode)
+{
+	// a ring with a bar roughly resembles the outline of a large glyph
+	int size = DILATION_BENCHMARK_SYMBOL_SIZE;
+	int fastTime = 0;
+	int imageTime = 0;
+	int64_t start = 0;
+	int borderSize = 0;
+	april::Image* symbol = NULL;
+	april::Image* image = NULL;
+	april::Image* structuringImage = NULL;
+	for_iter (thickness, 1, DILATION_BENCHMARK_MAX_THICKNESS + 1)
+	{
+		borderSize = thickness;
+		symbol = april::Image::create(size + borderSize * 2, size + borderSize * 2, april::Color::Clear, april::Image::Format::Alpha);
+		symbol->fillRect(borderSize + size / 8, borderSize + size / 8, size * 3 / 4, size * 3 / 4, april::Color::White);
+		symbol->fillRect(borderSize + size / 4, borderSize + size / 4, size / 2, size / 2, april::Color::Clear);
+		symbol->fillRect(borderSize + size / 8, borderSize + size / 2 - 2, size * 3 / 4, 4, april::Color::White);
+		structuringImage = atres::FontDynamic::createStructuringImage(borderMode, (float)thickness);
+		start = htickCount();
+		for_iter (i, 0, DILATION_BENCHMARK_ITERATIONS)
+		{
+			image = april::Image::create(symbol);
+			image->dilate(structuringImage);
+			delete image;
+		}
+		imageTime = (int)(htickCount() - start);
+		start = htickCount();
+		for_iter (i, 0, DILATION_BENCHMARK_ITERATIONS)
+		{
+			image = april::Image::create(symbol);
+			atres::FontDynamic::dilateBorderImage(image, borderMode, (float)thickness);
+			delete image;
+		}
+		fastTime = (int)(htickCount() - start);
+		hlog::writef(LOG_TAG, "%s dilation with thickness %d, %d iterations: Image::dilate() %d ms, specialized %d ms", borderMode.getName().cStr(),
+			thickness, DILATION_BENCHMARK_ITERATIONS, imageTime, fastTime);
+		delete structuringImage;
+		delete symbol;
+	}
+}
+
+void checkDistanceField()
+{
+	// an antialiased disc is encoded and decoded at the reference size, the result has to match the original coverage
+	int size = (int)(DISTANCE_FIELD_CHECK_RADIUS * 2) + 4;
+	int spread = DISTANCE_FIELD_CHECK_SPREAD;
+	april::Image* symbol = april::Image::create(size, size, april::Color::Clear, april::Image::Format::Alpha);
+	float dx = 0.0f;
+	float dy = 0.0f;
+	for_iter (y, 0, size)
+	{
+		for_iter (x, 0, size)
+		{
+			dx = x + 0.5f - size * 0.5f;
+			dy = y + 0.5f - size * 0.5f;
+			symbol->data[x + y * size] = (unsigned char)(hclamp(DISTANCE_FIELD_CHECK_RADIUS - hsqrt(dx * dx + dy * dy), 0.0f, 1.0f) * 255);
+		}
+	}
+	april::Image* field = atres::FontDynamic::createDistanceField(symbol, spread);
+	april::Image* image = atres::FontDynamic::decodeDistanceField(field, spread, 1.0f);
+	int maxError = 0;
+	for_iter (y, 0, size)
+	{
+		for_iter (x, 0, size)
+		{
+			maxError = hmax(maxError, habs((int)image->data[x + spread + (y + spread) * image->w] - (int)symbol->data[x + y * size]));
+		}
+	}
+	if (maxError <= DISTANCE_FIELD_CHECK_MAX_ERROR)
+	{
+		hlog::writef(LOG_TAG, "Distance field round-trip: max error %d/255 (allowed %d)", maxError, DISTANCE_FIELD_CHECK_MAX_ERROR);
+	}
+	else
+	{
+		hlog::errorf(LOG_TAG, "Distance field round-trip failed: max error %d/255 (allowed %d)", maxError, DISTANCE_FIELD_CHECK_MAX_ERROR);
+	}
+	delete image;
+	delete field;
+	delete symbol;
+}
+
+int getTextureMemory(const harray<april::Texture*>& textures)
+{
+	int result = 0;
+	foreachc (april::Texture*, it, textures)
+	{
+		result += (*it)->getWidth() * (*it)->getHeight() * (*it)->getFormat().getBpp();
+	}
+	return result;
+}
+
+int getTextureMemory(atres::Font* font)
+{
+	return getTextureMemory(font->getTextures());
+}
+
+void logTextureMemory(chstr title, const harray<april::Texture*>& textures)
+{
+	hlog::writef(LOG_TAG, "%s: %d textures, %d KB", title.cStr(), textures.size(), getTextureMemory(textures) / 1024);
+}
+
+void logAtlas(chstr fontName)
+{
+	atres::FontDynamic* font = dynamic_cast<atres::FontDynamic*>(atres::renderer->getFont(fontName));
+	if (font == NULL)
+	{
+		hlog::warnf(LOG_TAG, "Font '%s' is not a dynamic font, it has no atlas.", fontName.cStr());
+		return;
+	}
+	hlog::writef(LOG_TAG, "Atlas of '%s' with %d characters: %d textures, %d KB, %.1f%% occupancy, %d textures recycled, %d characters pending", fontName.cStr(),
+		font->getCharacters().size(), font->getTextures().size(), getTextureMemory(font) / 1024, font->getAtlasOccupancy() * 100.0f, font->getRecycledTextureCount(),
+		font->getPendingCharacterCount());
+}
+
+#ifdef _ATRESTTF
+atresttf::FontTtf* createBenchmarkFont(chstr name, float height)
+{
+	// benchmarks use separate fonts from the default font's file so every run starts with empty textures
+	atresttf::FontTtf* defaultFont = dynamic_cast<atresttf::FontTtf*>(atres::renderer->getFont(atres::renderer->getDefaultFontName()));
+	if (defaultFont == NULL)
+	{
+		hlog::warnf(LOG_TAG, "Default font is not a TTF font, cannot create font '%s'.", name.cStr());
+		return NULL;
+	}
+	return new atresttf::FontTtf(defaultFont->getFontFilename(), name, height, 1.0f, 0.0f, false);
+}
+
+void benchmarkAtlas()
+{
+	harray<unsigned int> charCodes;
+	for_itert (unsigned int, code, ATLAS_BENCHMARK_FIRST_CHAR, ATLAS_BENCHMARK_LAST_CHAR + 1)
+	{
+		charCodes += code;
+	}
+	// characters are added one by one when texts need them and sorted by height when loaded at once
+	harray<unsigned int> charCode;
+	for_iter (i, 0, 2)
+	{
+		atresttf::FontTtf* font = createBenchmarkFont("Atlas", ATLAS_BENCHMARK_FONT_SIZE);
+		if (font == NULL)
+		{
+			return;
+		}
+		if (font->load())
+		{
+			if (i == 0)
+			{
+				foreach (unsigned int, it, charCodes)
+				{
+					charCode.clear();
+					charCode += (*it);
+					font->loadCharacters(charCode);
+				}
+			}
+			else
+			{
+				font->loadCharacters(charCodes);
+			}
+			logTextureMemory(hsprintf("Atlas with %d characters loaded %s (%.1f%% occupancy)", font->getCharacters().size(), (i == 0 ? "one by one" : "at once"),
+				font->getAtlasOccupancy() * 100.0f), font->getTextures());
+		}
+		delete font;
+	}
+}
+
+harray<unsigned int> loadJisLevel1CharCodes()
+{
+	harray<unsigned int> result;
+	std::ustring chars = hresource::hread(RESOURCE_PATH "jis_level1.txt").uStr();
+	for_itert (unsigned int, i, 0, chars.size())
+	{
+		if (chars[i] >= 0x80) // skips new lines
+		{
+			result += chars[i];
+		}
+	}
+	return result;
+}
+
+void benchmarkPackers(chstr title, const harray<unsigned int>& charCodes, float height)
+{
+	atresttf::FontTtf* font = createBenchmarkFont("Packers", height);
+	if (font == NULL)
+	{
+		return;
+	}
+	if (font->load())
+	{
+		// the skyline packer of the font places all characters at once
+		font->loadCharacters(charCodes);
+		hlog::writef(LOG_TAG, "%s, %d characters with skyline packer: %d textures, %d KB, %.1f%% occupancy", title.cStr(), font->getCharacters().size(),
+			font->getTextures().size(), getTextureMemory(font) / 1024, font->getAtlasOccupancy() * 100.0f);
+		// the previous shelf packer is replayed with the same symbol sizes in the order in which texts request them
+		int textureSize = font->getTextureSize();
+		int pageCount = 0;
+		int penX = 0;
+		int penY = 0;
+		int rowHeight = 0;
+		int width = 0;
+		int symbolHeight = 0;
+		int64_t usedArea = 0;
+		atres::CharacterDefinition* character = NULL;
+		foreachc (unsigned int, it, charCodes)
+		{
+			character = font->getCharacters().tryGet((*it), NULL);
+			if (character == NULL)
+			{
+				continue;
+			}
+			width = (int)character->rect.w;
+			symbolHeight = (int)character->rect.h;
+			if (pageCount == 0)
+			{
+				pageCount = 1;
+			}
+			if (penX + width + PACKER_BENCHMARK_CHARACTER_SPACE * 2 > textureSize)
+			{
+				penX = 0;
+				penY += rowHeight + PACKER_BENCHMARK_CHARACTER_SPACE * 2;
+				rowHeight = symbolHeight;
+			}
+			else
+			{
+				rowHeight = hmax(rowHeight, symbolHeight);
+			}
+			if (penY + rowHeight + PACKER_BENCHMARK_CHARACTER_SPACE * 2 > textureSize)
+			{
+				++pageCount;
+				penX = 0;
+				penY = 0;
+				rowHeight = symbolHeight;
+			}
+			penX += width + PACKER_BENCHMARK_CHARACTER_SPACE * 2;
+			usedArea += (width + PACKER_BENCHMARK_CHARACTER_SPACE * 2) * (symbolHeight + PACKER_BENCHMARK_CHARACTER_SPACE * 2);
+		}
+		harray<april::Texture*> textures = font->getTextures();
+		int64_t textureArea = (int64_t)pageCount * textureSize * textureSize;
+		int bpp = (textures.size() > 0 ? textures.first()->getFormat().getBpp() : 0);
+		hlog::writef(LOG_TAG, "%s, %d characters with shelf packer: %d textures, %d KB, %.1f%% occupancy", title.cStr(), font->getCharacters().size(),
+			pageCount, (int)(textureArea * bpp / 1024), (textureArea > 0 ? (float)((double)usedArea / textureArea) * 100.0f : 0.0f));
+	}
+	delete font;
+}
+
+void benchmarkPrewarm(int loaderThreadCount)
+{
+	atresttf::FontTtf* font = createBenchmarkFont("JIS Prewarm", 32.0f);
+	if (font == NULL)
+	{
+		return;
+	}
+	harray<unsigned int> charCodes = loadJisLevel1CharCodes();
+	font->setLoaderThreadCount(loaderThreadCount);
+	if (font->load())
+	{
+		int64_t start = htickCount();
+		font->loadCharacters(charCodes);
+		hlog::writef(LOG_TAG, "JIS level-1 prewarm of %d characters with %d loader threads: %d ms, %d textures", charCodes.size(), loaderThreadCount,
+			(int)(htickCount() - start), font->getTextures().size());
+	}
+	delete font;
+}
+
+void benchmarkNativeBorders()
+{
+	atresttf::FontTtf* font = createBenchmarkFont("Border Prewarm", 32.0f);
+	if (font == NULL)
+	{
+		return;
+	}
+	font->setBorderMode(atres::Font::BorderMode::FontNative);
+	if (font->load())
+	{
+		int64_t start = htickCount();
+		font->loadBasicAsciiCharacters(); // the glyph outlines are loaded with the first border thickness
+		hlog::writef(LOG_TAG, "ASCII prewarm: %d ms", (int)(htickCount() - start));
+		float thickness = 0.0f;
+		for_iter (i, 1, BORDER_BENCHMARK_THICKNESS_COUNT + 1)
+		{
+			thickness = i * 1.5f;
+			start = htickCount();
+			font->loadBasicAsciiBorderCharacters(thickness);
+			hlog::writef(LOG_TAG, "ASCII native border prewarm with thickness %.1f: %d ms", thickness, (int)(htickCount() - start));
+		}
+	}
+	delete font;
+}
+
+void benchmarkDistanceFieldMemory()
+{
+	atresttf::FontTtf* font = createBenchmarkFont("Prerendered Borders", 32.0f);
+	if (font == NULL)
+	{
+		return;
+	}
+	font->setBorderMode(atres::Font::BorderMode::PrerenderCircle);
+	if (font->load())
+	{
+		font->loadBasicAsciiCharacters();
+		// fonts render coverage textures only, distance fields made offline with FontDynamic::createDistanceField() would need the characters plus the spread
+		harray<april::Texture*> textures = font->getTextures();
+		int bpp = (textures.size() > 0 ? textures.first()->getFormat().getBpp() : 0);
+		int spread = DISTANCE_FIELD_CHECK_SPREAD;
+		int64_t fieldArea = 0;
+		foreach_map (unsigned int, atres::CharacterDefinition*, it, font->getCharacters())
+		{
+			fieldArea += (int64_t)(it->second->rect.w + (spread + PACKER_BENCHMARK_CHARACTER_SPACE) * 2) * (int64_t)(it->second->rect.h + (spread + PACKER_BENCHMARK_CHARACTER_SPACE) * 2);
+		}
+		for_iter (i, 1, BORDER_BENCHMARK_THICKNESS_COUNT + 1)
+		{
+			font->loadBasicAsciiBorderCharacters(i * 1.5f);
+		}
+		logTextureMemory(hsprintf("ASCII with %d prerendered border thicknesses", BORDER_BENCHMARK_THICKNESS_COUNT), font->getTextures());
+		hlog::writef(LOG_TAG, "ASCII as offline distance fields with spread %d: at least %d KB for all scales and border thicknesses up to %d px", spread,
+			(int)(fieldArea * bpp / 1024), spread);
+	}
+	delete font;
+}
+
+void benchmarkAtlasPool()
+{
+	harray<unsigned int> digits;
+	for_iter (i, '0', '9' + 1)
+	{
+		digits += (unsigned int)i;
+	}
+	// a text font, a digits-only font and a bordered font, first with their own textures and then sharing one pool
+	atres::TextureAtlasPool* pool = NULL;
+	for_iter (i, 0, 2)
+	{
+		if (i == 1)
+		{
+			pool = new atres::TextureAtlasPool(atres::getTextureSize());
+		}
+		atresttf::FontTtf* text = createBenchmarkFont("Pool Text", 24.0f);
+		if (text == NULL)
+		{
+			break;
+		}
+		atresttf::FontTtf* numbers = createBenchmarkFont("Pool Digits", 40.0f);
+		atresttf::FontTtf* bordered = createBenchmarkFont("Pool Borders", 32.0f);
+		text->setAtlasPool(pool);
+		numbers->setAtlasPool(pool);
+		bordered->setAtlasPool(pool);
+		bordered->setBorderMode(atres::Font::BorderMode::PrerenderCircle);
+		if (text->load() && numbers->load() && bordered->load())
+		{
+			text->loadBasicAsciiCharacters();
+			numbers->loadCharacters(digits);
+			bordered->loadBasicAsciiCharacters();
+			bordered->loadBasicAsciiBorderCharacters(2.0f);
+			if (pool == NULL)
+			{
+				logTextureMemory("Separate atlases", text->getTextures() + numbers->getTextures() + bordered->getTextures());
+			}
+			else
+			{
+				logTextureMemory(hsprintf("Shared atlas pool (%d%% occupancy)", (int)(pool->getOccupancy() * 100.0f)), pool->getTextures());
+				// the areas of a destroyed font are reused by the next one
+				delete text;
+				text = createBenchmarkFont("Pool Text Reloaded", 24.0f);
+				text->setAtlasPool(pool);
+				if (text->load())
+				{
+					text->loadBasicAsciiCharacters();
+					logTextureMemory(hsprintf("Shared atlas pool after replacing a font (%d%% occupancy)", (int)(pool->getOccupancy() * 100.0f)), pool->getTextures());
+				}
+			}
+		}
+		delete text;
+		delete numbers;
+		delete bordered;
+	}
+	delete pool;
+}
+
+void benchmarkChannelPacking()
+{
+	// simulates a device without alpha textures
+	bool allowAlphaTextures = atres::isAllowAlphaTextures();
+	atres::setAllowAlphaTextures(false);
+	for_iter (i, 0, 2)
+	{
+		atresttf::FontTtf* font = createBenchmarkFont("Channel Packing", 32.0f);
+		if (font == NULL)
+		{
+			break;
+		}
+		font->setChannelPacking(i == 1);
+		font->setBorderMode(atres::Font::BorderMode::PrerenderCircle);
+		if (font->load())
+		{
+			font->loadBasicAsciiCharacters();
+			font->loadBasicAsciiBorderCharacters(2.0f);
+			logTextureMemory(hsprintf("ASCII with borders on RGBA textures, channel packing %s", font->isChannelPacking() ? "on" : "off"), font->getTextures());
+		}
+		delete font;
+	}
+	atres::setAllowAlphaTextures(allowAlphaTextures);
+}
+#endif
+
 class KeyDelegate : public april::KeyDelegate
 {
 public:
@@ -88,6 +534,97 @@ public:
 		{
 			atres::renderer->setBorderThickness(hrandf(1.0f, 5.0f));
 		}
+		else if (keyCode == april::Key::B)
+		{
+			atres::renderer->setBatching(!atres::renderer->isBatching());
+			hlog::writef(LOG_TAG, "Batching: %s", atres::renderer->isBatching() ? "on" : "off");
+		}
+		else if (keyCode == april::Key::V)
+		{
+			atres::renderer->setUseVertexColors(!atres::renderer->isUseVertexColors());
+			hlog::writef(LOG_TAG, "Vertex colors: %s", atres::renderer->isUseVertexColors() ? "on" : "off");
+		}
+		else if (keyCode == april::Key::E)
+		{
+			atres::renderer->setUseEffectPasses(!atres::renderer->isUseEffectPasses());
+			hlog::writef(LOG_TAG, "Effect passes: %s", atres::renderer->isUseEffectPasses() ? "on" : "off");
+		}
+		else if (keyCode == april::Key::L)
+		{
+			benchmarkLayout("Bordered text layout", "", textArea3, TEXT_BORDER_BENCHMARK);
+		}
+		else if (keyCode == april::Key::K)
+		{
+			benchmarkLayout("Latin paragraph layout", "", textArea6, TEXT_LATIN_BENCHMARK);
+		}
+		else if (keyCode == april::Key::D)
+		{
+			benchmarkDilation(atres::Font::BorderMode::PrerenderSquare);
+			benchmarkDilation(atres::Font::BorderMode::PrerenderCircle);
+			benchmarkDilation(atres::Font::BorderMode::PrerenderDiamond);
+		}
+		else if (keyCode == april::Key::R)
+		{
+			checkDistanceField();
+		}
+		else if (keyCode == april::Key::O)
+		{
+			logAtlas(atres::renderer->getDefaultFontName());
+#ifdef _ATRESTTF
+			benchmarkAtlas();
+#endif
+		}
+#ifdef _ATRESTTF
+		else if (keyCode == april::Key::J)
+		{
+			benchmarkPrewarm(1);
+			benchmarkPrewarm(PREWARM_BENCHMARK_THREAD_COUNT);
+		}
+		else if (keyCode == april::Key::G)
+		{
+			harray<unsigned int> charCodes;
+			for_itert (unsigned int, code, ATLAS_BENCHMARK_FIRST_CHAR, ATLAS_BENCHMARK_LAST_CHAR + 1)
+			{
+				charCodes += code;
+			}
+			benchmarkPackers("Latin", charCodes, ATLAS_BENCHMARK_FONT_SIZE);
+			benchmarkPackers("JIS level-1", loadJisLevel1CharCodes(), 32.0f);
+		}
+		else if (keyCode == april::Key::N)
+		{
+			benchmarkNativeBorders();
+		}
+		else if (keyCode == april::Key::F)
+		{
+			benchmarkDistanceFieldMemory();
+		}
+		else if (keyCode == april::Key::C)
+		{
+			benchmarkChannelPacking();
+		}
+		else if (keyCode == april::Key::P)
+		{
+			benchmarkAtlasPool();
+		}
+		else if (keyCode == april::Key::S)
+		{
+			atresttf::FontTtf* font = dynamic_cast<atresttf::FontTtf*>(atres::renderer->getFont(atres::renderer->getDefaultFontName()));
+			if (font != NULL)
+			{
+				font->setSizeBuckets(!font->isSizeBuckets());
+				hlog::writef(LOG_TAG, "Size buckets: %s, %d KB base textures", font->isSizeBuckets() ? "on" : "off", getTextureMemory(font) / 1024);
+			}
+		}
+#endif
+		else if (keyCode == april::Key::A)
+		{
+			atres::FontDynamic* font = dynamic_cast<atres::FontDynamic*>(atres::renderer->getFont(atres::renderer->getDefaultFontName()));
+			if (font != NULL)
+			{
+				font->setAsyncLoading(!font->isAsyncLoading());
+				hlog::writef(LOG_TAG, "Asynchronous character loading: %s", font->isAsyncLoading() ? "on" : "off");
+			}
+		}
 	}
 
 	void onChar(unsigned int charCode)
@@ -147,13 +684,23 @@ class UpdateDelegate : public april::UpdateDelegate
 public:
 	april::Color color;
 
-	UpdateDelegate() : april::UpdateDelegate(), time(0.0f)
+	UpdateDelegate() : april::UpdateDelegate(), time(0.0f), statsTime(0.0f), frames(0)
 	{
 	}
 	
 	bool onUpdate(float timeDelta)
 	{
 		this->time += timeDelta;
+		this->statsTime += timeDelta;
+		++this->frames;
+		if (this->statsTime >= 1.0f)
+		{
+			hlog::writef(LOG_TAG, "Text draw calls per frame: %.1f (batching %s)", (float)atres::renderer->getDrawCallCount() / this->frames,
+				atres::renderer->isBatching() ? "on" : "off");
+			atres::renderer->resetDrawCallCount();
+			this->statsTime = 0.0f;
+			this->frames = 0;
+		}
 		this->color.a = 191 + (unsigned char)(64 * hsin(this->time * 360.0f));
 		// rendering
 		april::rendersys->clear();
@@ -175,11 +722,14 @@ public:
 		atres::renderer->drawText("Arial:0.8", textArea4, TEXT_4, atres::Horizontal::Justified, atres::Vertical::Center, this->color);
 		atres::renderer->drawText(textArea5, TEXT_5, atres::Horizontal::Center, atres::Vertical::Center, april::Color::White, mouseDelegate->offset);
 		atres::renderer->drawText(textArea6, TEXT_6, atres::Horizontal::Center, atres::Vertical::Center, april::Color::White, mouseDelegate->offset);
+		atres::renderer->flush();
 		return true;
 	}
 
 protected:
 	float time;
+	float statsTime;
+	int frames;
 
 };
 
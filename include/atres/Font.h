@@ -69,6 +69,11 @@ namespace atres
 		float getScale() const;
 		/// @brief Set the scale of the font.
 		HL_DEFINE_SET(float, scale, Scale);
+		/// @brief Gets the font that is used to render at a given scale.
+		/// @param[in] scale The scale of the font.
+		/// @return The font with the scale applied.
+		/// @note Fonts can use a differently rasterized font for some scales, by default the font itself is used.
+		virtual Font* getScaledFont(float scale);
 		/// @brief Internal base scale of the font.
 		HL_DEFINE_GETSET(float, baseScale, BaseScale);
 		/// @brief Gets the line-height of the font.
@@ -98,18 +103,49 @@ namespace atres
 		/// @brief Gets all character definitions.
 		/// @return All character definitions.
 		inline hmap<unsigned int, CharacterDefinition*>& getCharacters() { return this->characters; }
+		/// @brief Gets the character lookup table used during text layout.
+		/// @return The character lookup table.
+		inline const GlyphTable& getGlyphs() const { return this->glyphs; }
 		/// @brief Gets all border character definitions.
 		/// @return All border character definitions.
-		inline hmap<unsigned int, harray<BorderCharacterDefinition*> >& getBorderCharacters() { return this->borderCharacters; }
+		/// @note Definitions are grouped by border thickness ID, see makeBorderThicknessId().
+		inline hmap<int, hmap<unsigned int, BorderCharacterDefinition*> >& getBorderCharacters() { return this->borderCharacters; }
 		/// @brief Gets all icon definitions.
 		/// @return All icon definitions.
 		inline hmap<hstr, IconDefinition*>& getIcons() { return this->icons; }
 		/// @brief Gets all border icon definitions.
 		/// @return All border icon definitions.
-		inline hmap<hstr, harray<BorderIconDefinition*> >& getBorderIcons() { return this->borderIcons; }
+		/// @note Definitions are grouped by border thickness ID, see makeBorderThicknessId().
+		inline hmap<int, hmap<hstr, BorderIconDefinition*> >& getBorderIcons() { return this->borderIcons; }
 		/// @brief Gets all internal textures.
 		/// @return All internal textures.
 		harray<april::Texture*> getTextures() const;
+		/// @brief Uploads pending changes of the font's textures.
+		/// @return The number of uploaded textures.
+		/// @note The renderer calls this before it renders anything.
+		virtual int uploadTextures();
+		/// @brief Marks a texture of this font as used in the renderer's current frame.
+		/// @param[in] texture The texture.
+		/// @return True if the texture belongs to this font.
+		/// @note Textures used in the current frame will not be recycled.
+		virtual bool markTextureUsed(april::Texture* texture);
+		/// @brief Whether the font needs to know which of its textures are used in the renderer's current frame.
+		/// @return True if the font needs to know which of its textures are used.
+		/// @note The renderer calls markTextureUsed() only when at least one font needs it.
+		/// @note Implementations call _updateTextureUsageTracking() when the result can change because the renderer caches it.
+		virtual bool isTextureUsageTracked() const;
+		/// @brief Finds the texture coordinates of a solid white area in one of the font's textures.
+		/// @param[in] texture The texture.
+		/// @param[out] uv Normalized texture coordinates of the solid white area.
+		/// @return True if the texture belongs to this font and has a solid white area.
+		/// @note This allows rendering untextured geometry in the same render call as the symbols.
+		virtual bool findWhiteTexel(april::Texture* texture, gvec2f& uv) const;
+		/// @brief Gets a texture that holds only one color channel of a channel-packed texture of this font as alpha.
+		/// @param[in] texture The channel-packed texture.
+		/// @param[in] channel The color channel.
+		/// @return The channel texture or NULL if the texture doesn't belong to this font or isn't channel-packed.
+		/// @note This allows rendering channel-packed symbols with the stock color modes.
+		virtual april::Texture* getChannelTexture(april::Texture* texture, int channel);
 
 		/// @brief Get the texture where the character definition for a specific char code is currently contained.
 		/// @param[in] charCode Character unicode value.
@@ -132,6 +168,7 @@ namespace atres
 		/// @brief Checks if a character definition has been loaded already.
 		/// @param[in] charCode Character unicode value.
 		/// @return True if character is loaded.
+		/// @note Creates the glyph table entry of a character definition that was added without _updateGlyph().
 		virtual bool hasCharacter(unsigned int charCode);
 		/// @brief Checks if a border character definition has been loaded already.
 		/// @param[in] charCode Character unicode value.
@@ -147,6 +184,15 @@ namespace atres
 		/// @param[in] borderThickness Thickness of the border.
 		/// @return True if border icon is loaded.
 		virtual bool hasBorderIcon(chstr iconName, float borderThickness);
+		/// @brief Converts a border thickness into the ID used to group border symbols.
+		/// @param[in] borderThickness Thickness of the border.
+		/// @return The border thickness ID.
+		/// @note Thicknesses that differ by less than the quantization step share the same ID, see atres::setBorderThicknessStep().
+		static int makeBorderThicknessId(float borderThickness);
+		/// @brief Rounds a border thickness to the quantization step.
+		/// @param[in] borderThickness Thickness of the border.
+		/// @return The thickness that is used for all border symbols with the same border thickness ID.
+		static float quantizeBorderThickness(float borderThickness);
 		/// @brief Get the border character definition for a specific char code.
 		/// @param[in] charCode Character unicode value.
 		/// @param[in] borderThickness Thickness of the border.
@@ -195,9 +241,18 @@ namespace atres
 		/// @param[in] iconName Icon name.
 		/// @return True if icon is loaded.
 		virtual void loadBasicAsciiCharacters();
+		/// @brief Loads multiple characters at once.
+		/// @param[in] charCodes Character unicode values.
+		/// @note Fonts that create characters on demand can arrange all characters on their textures together which is more efficient than loading them one by one.
+		virtual void loadCharacters(const harray<unsigned int>& charCodes);
 		/// @brief Loads basic ASCII range of border characters.
 		/// @param[in] borderThickness Thickness of the border.
 		virtual void loadBasicAsciiBorderCharacters(float borderThickness);
+		/// @brief Loads multiple border characters at once.
+		/// @param[in] charCodes Character unicode values.
+		/// @param[in] borderThickness Thickness of the border.
+		/// @note Fonts that create border characters on demand can arrange them on their textures together which is more efficient than loading them one by one.
+		virtual void loadBorderCharacters(const harray<unsigned int>& charCodes, float borderThickness);
 
 		/// @brief The default border rendering mode for all fonts.
 		static BorderMode defaultBorderMode;
@@ -229,21 +284,42 @@ namespace atres
 		BorderMode borderMode;
 		/// @brief All character definitions.
 		hmap<unsigned int, CharacterDefinition*> characters;
-		/// @brief All border character definitions.
-		hmap<unsigned int, harray<BorderCharacterDefinition*> > borderCharacters;
+		/// @brief Lookup table with plain copies of all character definitions.
+		GlyphTable glyphs;
+		/// @brief All border character definitions by border thickness ID.
+		hmap<int, hmap<unsigned int, BorderCharacterDefinition*> > borderCharacters;
 		/// @brief All icon definitions.
 		hmap<hstr, IconDefinition*> icons;
-		/// @brief All border icon definitions.
-		hmap<hstr, harray<BorderIconDefinition*> > borderIcons;
+		/// @brief All border icon definitions by border thickness ID.
+		hmap<int, hmap<hstr, BorderIconDefinition*> > borderIcons;
 		/// @brief Texture containers for all loaded characters and icons.
 		harray<TextureContainer*> textureContainers;
 		/// @brief Texture containers for all loaded border characters and border icons.
 		harray<BorderTextureContainer*> borderTextureContainers;
+		/// @brief Texture containers for border characters and border icons by border thickness ID.
+		/// @note These are the same objects as in borderTextureContainers, grouped for direct access.
+		hmap<int, harray<TextureContainer*> > thicknessBorderTextureContainers;
 
-		/// @brief Gets the texture container for a given border thickness.
+		/// @brief Gets the texture containers for a given border thickness.
+		/// @param[in] borderThickness border thickness.
+		/// @return The texture containers.
+		/// @note An empty entry is created if there are no texture containers for this border thickness yet.
+		harray<TextureContainer*>& _getBorderTextureContainers(float borderThickness);
+		/// @brief Finds the texture containers for a given border thickness without creating an entry.
 		/// @param[in] borderThickness border thickness.
-		/// @return The texture container.
-		harray<BorderTextureContainer*> _getBorderTextureContainers(float borderThickness) const;
+		/// @return The texture containers or NULL if there are none for this border thickness.
+		const harray<TextureContainer*>* _findBorderTextureContainers(float borderThickness) const;
+		/// @brief Gets the renderer's current frame used for tracking texture usage.
+		/// @return The renderer's current frame.
+		static int _getCurrentFrame();
+		/// @brief Notifies the renderer that the result of isTextureUsageTracked() can have changed.
+		static void _updateTextureUsageTracking();
+		/// @brief Updates the lookup table entry of a character from its character definition.
+		/// @param[in] charCode Character unicode value.
+		/// @note Has to be called whenever a character definition is added, changed or removed.
+		void _updateGlyph(unsigned int charCode);
+		/// @brief Destroys all border character definitions, border icon definitions and border texture containers.
+		void _destroyBorderSymbols();
 
 		/// @brief Loads the font definition.
 		/// @return True if successfully loaded.
@@ -266,6 +342,11 @@ namespace atres
 		/// @param[in] symbolRect Rect of symbol used.
 		/// @param[in] offsetY Vertical offset.
 		void _applyCutoff(cgrectf rect, cgrectf area, cgrectf symbolRect, float offsetY = 0.0f) const;
+		/// @brief Applies the cut-off to the rendering rect and area using already normalized texture coordinates.
+		/// @param[in] rect Container rect for text (used for clipping).
+		/// @param[in] area Rect where text should be rendered.
+		/// @param[in] uvRect Normalized texture coordinates of the symbol used.
+		void _applyUvCutoff(cgrectf rect, cgrectf area, cgrectf uvRect) const;
 		
 	};
 
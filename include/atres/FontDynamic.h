@@ -14,7 +14,9 @@
 #define ATRESTTF_FONT_DYNAMIC_H
 
 #include <hltypes/harray.h>
+#include <hltypes/hmutex.h>
 #include <hltypes/hstring.h>
+#include <hltypes/hthread.h>
 
 #include "atresExport.h"
 #include "Font.h"
@@ -41,10 +43,89 @@ namespace atres
 		~FontDynamic();
 
 		/// @brief The texture size of the font.
+		/// @note Textures start with minTextureSize and double their size when they are full until they reach this size.
 		HL_DEFINE_GET(int, textureSize, textureSize);
+		/// @brief The size new textures of the font start with.
+		/// @note A value of 0 or less creates textures with the full size right away. Shared atlas pages always have the full size.
+		/// @note Growing a texture replaces it so texts using it are removed from the renderer's cache.
+		/// @note Replaced textures are destroyed once the renderer frame advances, see Renderer::update().
+		HL_DEFINE_GETSET(int, minTextureSize, MinTextureSize);
+		/// @brief The maximum number of textures the font should use per symbol type before recycling the least recently used texture.
+		/// @note A value of 0 or less means no limit. Recycled symbols are created again when needed.
+		/// @note Applies separately to the character textures and to the textures of each border thickness.
+		/// @note Textures used in the current renderer frame are never recycled so the limit can be exceeded temporarily.
+		/// @note Requires the renderer frame to advance, see Renderer::update().
+		HL_DEFINE_GET(int, maxTextureCount, MaxTextureCount);
+		/// @brief Sets the maximum number of textures the font should use per symbol type before recycling the least recently used texture.
+		/// @param[in] value The maximum number of textures.
+		void setMaxTextureCount(int value);
+		/// @brief The maximum number of border thicknesses that keep their border symbols at the same time.
+		/// @note A value of 0 or less means no limit. The least recently used border thickness and its textures are destroyed when a new one is needed.
+		/// @note Border thicknesses used in the current renderer frame are never destroyed so the limit can be exceeded temporarily.
+		/// @note Useful with animated border thicknesses together with atres::setBorderThicknessStep().
+		/// @note Requires the renderer frame to advance, see Renderer::update().
+		HL_DEFINE_GET(int, maxBorderThicknessCount, MaxBorderThicknessCount);
+		/// @brief Sets the maximum number of border thicknesses that keep their border symbols at the same time.
+		/// @param[in] value The maximum number of border thicknesses.
+		void setMaxBorderThicknessCount(int value);
+		/// @brief The number of times a texture was recycled.
+		HL_DEFINE_GET(int, recycledTextureCount, RecycledTextureCount);
+		/// @brief The number of texture uploads since the last reset of the upload statistics.
+		HL_DEFINE_GET(int, uploadCount, UploadCount);
+		/// @brief The time in microseconds spent uploading textures since the last reset of the upload statistics.
+		/// @note Measured with std::chrono::steady_clock because single uploads are mostly below the resolution of htickCount().
+		HL_DEFINE_GET(int64_t, uploadTime, UploadTime);
+		/// @brief The number of uploaded pixels since the last reset of the upload statistics.
+		HL_DEFINE_GET(int64_t, uploadArea, UploadArea);
+		/// @brief Whether missing characters are loaded asynchronously.
+		/// @note Texts are created with the character metrics right away while the character images are added to the textures once they are loaded.
+		HL_DEFINE_IS(asyncLoading, AsyncLoading);
+		/// @brief Sets whether missing characters are loaded asynchronously.
+		/// @param[in] value Whether missing characters are loaded asynchronously.
+		/// @note Turning it off loads all pending characters right away.
+		/// @note Loaded characters are added to the textures once per renderer frame so the frame has to advance, see Renderer::update().
+		void setAsyncLoading(bool value);
+		/// @brief The maximum number of asynchronously loaded characters that are added to the textures per renderer frame.
+		/// @note A value of 0 or less means no limit.
+		HL_DEFINE_GETSET(int, asyncCharactersPerFrame, AsyncCharactersPerFrame);
+		/// @brief The number of threads used for asynchronous loading and for loading multiple characters at once.
+		/// @note Multiple characters are loaded in parallel only when more than one thread is used.
+		HL_DEFINE_GET(int, loaderThreadCount, LoaderThreadCount);
+		/// @brief Sets the number of threads used for asynchronous loading and for loading multiple characters at once.
+		/// @param[in] value The number of threads.
+		void setLoaderThreadCount(int value);
+		/// @brief Gets the number of border thicknesses that currently have border symbols.
+		/// @return The number of border thicknesses that currently have border symbols.
+		int getBorderThicknessCount() const;
+		/// @brief Gets the number of characters that are still being loaded asynchronously.
+		/// @return The number of characters that are still being loaded asynchronously.
+		int getPendingCharacterCount();
 		/// @brief Sets the border rendering mode.
 		/// @param[in] value The border rendering mode.
 		void setBorderMode(const BorderMode& value);
+		/// @brief The shared atlas pool the font places its symbols on.
+		/// @note NULL if the font uses its own textures.
+		HL_DEFINE_GET(TextureAtlasPool*, atlasPool, AtlasPool);
+		/// @brief Sets the shared atlas pool the font places its symbols on.
+		/// @param[in] value The atlas pool or NULL to use the font's own textures.
+		/// @note Has to be set before any symbols are loaded. The pool's texture size is used instead of the font's.
+		/// @note The areas of a destroyed font or an evicted border thickness are reused for other symbols on the same page.
+		/// @note Symbols on shared pages are never recycled, maxTextureCount only applies to the font's own textures.
+		void setAtlasPool(TextureAtlasPool* value);
+		/// @brief Whether RGBA textures hold four planes of symbols in their red, green, blue and alpha channels.
+		/// @note Only used for the font's own textures when the font cannot use alpha-textures, not for shared atlas pages. Symbol images are reduced to their alpha.
+		/// @note The channel of a packed symbol is kept in the render sequences and batches, texture coordinates stay normal. Each channel counts as a texture for maxTextureCount.
+		/// @note The renderer samples a channel through a texture that holds only that channel as alpha, see Font::getChannelTexture(). These are created on demand
+		/// and use additional memory, so packing pays off mostly when the sequences are rendered with a shader that selects the channel directly.
+		/// A warning is logged when the first packed texture is created.
+		HL_DEFINE_IS(channelPacking, ChannelPacking);
+		/// @brief Sets whether RGBA textures hold four planes of symbols in their color channels.
+		/// @param[in] value Whether RGBA textures hold four planes of symbols in their color channels.
+		/// @note Has to be set before any symbols are loaded.
+		void setChannelPacking(bool value);
+		/// @brief Whether prerendered borders use the specialized dilation kernels instead of april::Image::dilate().
+		/// @note The square kernel gives the same result, the circle and diamond kernels treat pixels with at least half coverage as inside the symbol.
+		HL_DEFINE_ISSET(fastDilation, FastDilation);
 
 		/// @brief Get the texture where the character definition for a specific char code is currently contained.
 		/// @param[in] charCode Character unicode value.
@@ -83,13 +164,70 @@ namespace atres
 		/// @return True if border icon is loaded.
 		bool hasBorderIcon(chstr iconName, float borderThickness);
 
+		/// @brief Uploads all changed texture areas.
+		/// @return The number of uploaded textures.
+		/// @note New symbols are written into a CPU-side copy of the texture first so that all symbols added within a frame require only one upload per texture.
+		int uploadTextures();
+		/// @brief Marks a texture of this font as used in the renderer's current frame.
+		/// @param[in] texture The texture.
+		/// @return True if the texture belongs to this font.
+		/// @note Also keeps textures that were replaced by bigger ones alive while they are still used.
+		bool markTextureUsed(april::Texture* texture);
+		/// @brief Whether the font needs to know which of its textures are used in the renderer's current frame.
+		/// @return True if a texture or border thickness limit, an atlas pool or replaced textures depend on texture usage.
+		bool isTextureUsageTracked() const;
+		/// @brief Resets the upload count, upload time and upload area.
+		void resetUploadStatistics();
+		/// @brief Gets the ratio of the area used by symbols to the total area of all textures.
+		/// @return The ratio of the area used by symbols to the total area of all textures.
+		float getAtlasOccupancy() const;
+
 		/// @brief Loads basic ASCII range of characters.
 		/// @param[in] iconName Icon name.
 		/// @return True if icon is loaded.
 		void loadBasicAsciiCharacters();
+		/// @brief Loads multiple characters at once.
+		/// @param[in] charCodes Character unicode values.
+		/// @note All missing character images are created first and then added to the textures sorted by height which uses the texture space better.
+		/// @note The character images are created in parallel if more than one loader thread is used.
+		void loadCharacters(const harray<unsigned int>& charCodes);
 		/// @brief Loads basic ASCII range of border characters.
 		/// @param[in] borderThickness Thickness of the border.
 		void loadBasicAsciiBorderCharacters(float borderThickness);
+		/// @brief Loads multiple border characters at once.
+		/// @param[in] charCodes Character unicode values.
+		/// @param[in] borderThickness Thickness of the border.
+		/// @note All missing border character images are created first and then added to the textures sorted by height which uses the texture space better.
+		void loadBorderCharacters(const harray<unsigned int>& charCodes, float borderThickness);
+
+		/// @brief Creates a signed distance field from a coverage image.
+		/// @param[in] image The coverage image.
+		/// @param[in] spread The distance in pixels at which the field saturates, also the margin that is added on each side.
+		/// @return The distance field as alpha image where 0.5 is the edge and higher values are inside.
+		/// @note Uses a linear time euclidean distance transform. Doesn't use any shared state so it can be called on multiple threads at the same time.
+		/// @note Meant for preparing symbol images offline, the renderer draws font textures as coverage and has no distance field shader.
+		static april::Image* createDistanceField(april::Image* image, int spread);
+		/// @brief Decodes a distance field into a coverage image the same way a distance field shader would.
+		/// @param[in] field The distance field.
+		/// @param[in] spread The spread that the distance field was created with.
+		/// @param[in] scale The scale at which the distance field is rendered.
+		/// @param[in] borderThickness Additional thickness in pixels of the reference size, for decoding borders.
+		/// @return The decoded coverage image.
+		/// @note Serves as a reference for shaders and allows testing the output without a render system.
+		static april::Image* decodeDistanceField(april::Image* field, int spread, float scale, float borderThickness = 0.0f);
+		/// @brief Creates the structuring image that april::Image::dilate() uses for a prerendered border rendering mode.
+		/// @param[in] borderMode The border rendering mode.
+		/// @param[in] borderThickness Thickness of the border.
+		/// @return The structuring image or NULL if the border rendering mode is not a prerendered one.
+		static april::Image* createStructuringImage(const BorderMode& borderMode, float borderThickness);
+		/// @brief Dilates an alpha image for a prerendered border rendering mode with the specialized kernels.
+		/// @param[in] image The image that is dilated in place. It needs enough transparent margin for the border.
+		/// @param[in] borderMode The border rendering mode.
+		/// @param[in] borderThickness Thickness of the border.
+		/// @return True if successful.
+		/// @note Square borders take constant time per pixel regardless of the thickness, circle and diamond borders use a linear time distance transform.
+		/// @note Doesn't use any shared state so it can be called for multiple images on different threads at the same time.
+		static bool dilateBorderImage(april::Image* image, const BorderMode& borderMode, float borderThickness);
 
 	protected:
 		/// @brief Helper class for structuring images when using a prerendered border rendering mode.
@@ -113,19 +251,119 @@ namespace atres
 
 		};
 
+		/// @brief Helper class for a loaded character image that has not been added to a texture yet.
+		class CharacterImageContainer
+		{
+		public:
+			/// @brief Character unicode value.
+			unsigned int charCode;
+			/// @brief The character image.
+			april::Image* image;
+			/// @brief Horizontal advance value.
+			float advance;
+			/// @brief Horizontal offset from the left boundary of the bitmap.
+			int leftOffset;
+			/// @brief Vertical offset from the top boundary of the bitmap.
+			int topOffset;
+			/// @brief Ascender value.
+			float ascender;
+			/// @brief Descender value.
+			float descender;
+			/// @brief Horizontal bearing.
+			float bearingX;
+
+			/// @brief Basic constructor.
+			/// @param[in] charCode Character unicode value.
+			CharacterImageContainer(unsigned int charCode = 0);
+
+		};
+
+		/// @brief Helper thread class that loads character images asynchronously.
+		class AsyncLoaderThread : public hthread
+		{
+		public:
+			/// @brief The font that loads characters.
+			FontDynamic* font;
+			/// @brief Index of the thread within the font's loader threads.
+			int index;
+			/// @brief Whether the thread stopped because there was nothing left to load.
+			/// @note Protected by the font's asyncMutex.
+			bool idle;
+
+			/// @brief Basic constructor.
+			/// @param[in] font The font that loads characters.
+			/// @param[in] index Index of the thread within the font's loader threads.
+			AsyncLoaderThread(FontDynamic* font, int index);
+
+		};
+
 		/// @brief Font texture size.
 		int textureSize;
+		/// @brief Initial font texture size.
+		int minTextureSize;
+		/// @brief Textures that were replaced by bigger ones and the last renderer frame in which they were used.
+		hmap<april::Texture*, int> retiredTextures;
+		/// @brief Maximum number of textures before recycling.
+		int maxTextureCount;
+		/// @brief Maximum number of border thicknesses before the least recently used one is destroyed.
+		int maxBorderThicknessCount;
+		/// @brief The shared atlas pool.
+		TextureAtlasPool* atlasPool;
+		/// @brief Whether RGBA textures hold four planes of symbols in their color channels.
+		bool channelPacking;
+		/// @brief Number of recycled textures.
+		int recycledTextureCount;
+		/// @brief Number of texture uploads.
+		int uploadCount;
+		/// @brief Time spent uploading textures in microseconds.
+		int64_t uploadTime;
+		/// @brief Number of uploaded pixels.
+		int64_t uploadArea;
 		/// @brief All structuring image containers.
 		harray<StructuringImageContainer*> structuringImageContainers;
+		/// @brief Whether prerendered borders use the specialized dilation kernels.
+		bool fastDilation;
+		/// @brief Whether missing characters are loaded asynchronously.
+		bool asyncLoading;
+		/// @brief Maximum number of asynchronously loaded characters added to the textures per frame.
+		int asyncCharactersPerFrame;
+		/// @brief Number of loader threads.
+		int loaderThreadCount;
+		/// @brief The threads that load character images.
+		harray<AsyncLoaderThread*> asyncThreads;
+		/// @brief Mutex for the queues and loaded characters of the loader threads.
+		hmutex asyncMutex;
+		/// @brief Char codes of characters waiting to be loaded asynchronously.
+		harray<unsigned int> asyncQueue;
+		/// @brief Asynchronously loaded character images waiting to be added to the textures.
+		harray<CharacterImageContainer> asyncLoadedCharacters;
+		/// @brief Char codes of characters waiting to be loaded in parallel for loadCharacters().
+		harray<unsigned int> asyncBatchQueue;
+		/// @brief Character images loaded in parallel for loadCharacters().
+		harray<CharacterImageContainer> asyncBatchLoadedCharacters;
+		/// @brief The last renderer frame in which asynchronously loaded characters were added to the textures.
+		int asyncFrame;
 
 		/// @brief Checks if alpha-textures can be used for this font.
 		/// @return True if alpha-textures can be used for this font.
 		virtual bool _isAllowAlphaTextures() const;
+		/// @brief Checks if characters can be loaded asynchronously in this font.
+		/// @return True if characters can be loaded asynchronously in this font.
+		/// @note Fonts that return true have to implement _loadCharacterMetrics() and _tryLoadCharacterImageAsync().
+		virtual bool _isAsyncLoadingSupported() const;
 		/// @brief Creates a texture contaner if there are none yet.
 		void _tryCreateFirstTextureContainer();
 		/// @brief Creates a texture contaner for border images if there are none yet.
 		/// @param[in] borderThickness The thickness of the border.
+		/// @note Destroys the least recently used border thickness if there are too many.
 		void _tryCreateFirstBorderTextureContainer(float borderThickness);
+		/// @brief Finds the least recently used border thickness that can be destroyed.
+		/// @param[out] borderThicknessId The border thickness ID.
+		/// @return True if a border thickness was found.
+		bool _findEvictableBorderThicknessId(int& borderThicknessId) const;
+		/// @brief Destroys all border symbols and textures of a border thickness.
+		/// @param[in] borderThicknessId The border thickness ID.
+		virtual void _evictBorderThickness(int borderThicknessId);
 
 		/// @brief Finds the given structuring image container for a given border render mode and thickness.
 		/// @param[in] borderMode The border render mode.
@@ -133,20 +371,135 @@ namespace atres
 		StructuringImageContainer* _findStructuringImageContainer(const BorderMode& borderMode, float borderThickness);
 
 		/// @brief Creates a new texture for the font symbols.
+		/// @param[in] textureSize The texture size.
+		/// @param[in] packed Whether the channels of an RGBA texture hold separate symbol planes.
 		/// @return A new texture.
-		april::Texture* _createTexture();
+		april::Texture* _createTexture(int textureSize, bool packed);
+		/// @brief Creates the texture of a texture container and reserves a solid white area on it.
+		/// @param[in] textureContainer The texture container.
+		/// @param[in] atlasPoolPage Whether the texture container is a new page of the shared atlas pool.
+		/// @note If the texture container already has a texture, the texture is cleared instead.
+		/// @note The solid white area allows rendering of linings in the same render call as the symbols.
+		void _initializeTextureContainer(TextureContainer* textureContainer, bool atlasPoolPage = false);
+		/// @brief Initializes a new texture container and adds it to the texture containers.
+		/// @param[in] textureContainers Proper symbol type texture containers.
+		/// @param[in] textureContainer The new texture container.
+		/// @note With channel packing, texture containers for the other color channels of the texture are added as well.
+		void _addTextureContainer(harray<TextureContainer*>& textureContainers, TextureContainer* textureContainer);
+		/// @brief Writes the alpha of an image into one color channel of another image.
+		/// @param[in] dest The destination image with 4 bytes per pixel.
+		/// @param[in] x Destination X coordinate.
+		/// @param[in] y Destination Y coordinate.
+		/// @param[in] channel The color channel.
+		/// @param[in] image The source image.
+		/// @return True if successful.
+		static bool _writeImageChannel(april::Image* dest, int x, int y, int channel, april::Image* image);
+		/// @brief Doubles the size of a texture until an area fits next to its current content.
+		/// @param[in] textureContainer The texture container.
+		/// @param[in] width Width of the area.
+		/// @param[in] height Height of the area.
+		/// @param[out] position The position where the area fits.
+		/// @return True if the area fits on the grown texture.
+		/// @note The content is copied to a new texture and the glyph UVs are updated, the old texture is kept until it is not used anymore.
+		bool _growTextureContainer(TextureContainer* textureContainer, int width, int height, gvec2i& position);
+		/// @brief Destroys textures that were replaced by bigger ones and are not used anymore.
+		void _updateRetiredTextures();
+		/// @brief Checks if the font can place its symbols on a shared atlas page.
+		/// @param[in] page The shared atlas page.
+		/// @return True if the font can place its symbols on the page.
+		/// @note Fonts that don't allow alpha-textures cannot use alpha pages.
+		bool _isAtlasPoolPageUsable(TextureContainer* page) const;
+		/// @brief Creates a new page in the shared atlas pool.
+		/// @return The new page or NULL if its texture could not be created.
+		TextureContainer* _createAtlasPoolPage();
+		/// @brief Makes a texture container use a shared atlas page.
+		/// @param[in] textureContainer The texture container.
+		/// @param[in] page The shared atlas page or NULL to use the last usable page or a new one.
+		/// @return True if the texture container uses a shared atlas page now.
+		bool _attachAtlasPoolPage(TextureContainer* textureContainer, TextureContainer* page);
+		/// @brief Reserves an area for a symbol on the shared atlas pages.
+		/// @param[in] textureContainers Proper symbol type texture containers.
+		/// @param[in,out] rect The area to reserve, its position is set to the reserved position.
+		/// @param[in] symbol The symbol value.
+		/// @return The texture container for the page with the reserved area or NULL if the symbol cannot fit on any page.
+		/// @note A new texture container is added to textureContainers when the font didn't use the page yet.
+		/// @note Released areas on the pages are used before the free area above the used ones.
+		TextureContainer* _reserveAtlasPoolArea(harray<TextureContainer*>& textureContainers, grecti& rect, chstr symbol);
 		/// @brief Attempts to add the character bitmap to the texture.
 		/// @param[in] charCode Character unicode value.
 		/// @param[in] initial Whether this is the first attempt to write on the texture (used for internal optimization).
 		/// @return True if successful.
 		/// @note Usually false is returned when the character couldn't be loaded or created properly from the font definition.
 		bool _tryAddCharacterBitmap(unsigned int charCode, bool initial = false);
+		/// @brief Loads the character image.
+		/// @param[in] charCode Character unicode value.
+		/// @param[in] initial Whether this is the first attempt to write on the texture (used for internal optimization).
+		/// @param[out] container The loaded character image and its metrics.
+		/// @return True if successful.
+		bool _tryLoadCharacterImage(unsigned int charCode, bool initial, CharacterImageContainer& container);
+		/// @brief Adds a loaded character image to the texture and creates the character definition.
+		/// @param[in] container The loaded character image and its metrics.
+		/// @param[in] initial Whether this is the first attempt to write on the texture (used for internal optimization).
+		/// @return True if successful.
+		/// @note The image is destroyed in the process.
+		bool _addCharacterImage(CharacterImageContainer& container, bool initial);
+		/// @brief Sets the metrics of a character definition.
+		/// @param[in] character The character definition.
+		/// @param[in] container The character metrics.
+		/// @param[in] imageWidth Width of the character image.
+		/// @param[in] imageHeight Height of the character image.
+		void _updateCharacterDefinition(CharacterDefinition* character, const CharacterImageContainer& container, int imageWidth, int imageHeight);
+		/// @brief Creates a pending character definition from the character metrics and queues the character image for asynchronous loading.
+		/// @param[in] charCode Character unicode value.
+		/// @return True if successful.
+		bool _tryAddPendingCharacter(unsigned int charCode);
+		/// @brief Starts the loader threads if they are not running yet.
+		/// @note Loader threads stop when their queues are empty so this has to be called after queueing characters to restart idle threads.
+		void _startAsyncLoading();
+		/// @brief Stops the loader threads.
+		/// @note Fonts that use their own resources in _tryLoadCharacterImageAsync() have to call this before destroying those resources.
+		void _stopAsyncLoading();
+		/// @brief Loads multiple character images in parallel on the loader threads.
+		/// @param[in] charCodes Character unicode values.
+		/// @param[out] containers The loaded character images and their metrics.
+		/// @note The calling thread loads characters as well and waits until all characters were processed.
+		/// @note The loader threads are stopped afterwards unless asynchronous loading keeps them running.
+		void _loadCharacterImagesParallel(const harray<unsigned int>& charCodes, harray<CharacterImageContainer>& containers);
+		/// @brief Adds asynchronously loaded character images to the textures within the per-frame limit.
+		void _updateAsyncLoading();
+		/// @brief Adds asynchronously loaded character images to the textures and removes pending characters that could not be loaded.
+		/// @param[in] containers The loaded character images and their metrics.
+		/// @note Cached texts with pending characters are removed from the renderer's cache.
+		void _addAsyncLoadedCharacterImages(harray<CharacterImageContainer>& containers);
+		/// @brief Adds multiple loaded character images to the textures, sorted by height.
+		/// @param[in] containers The loaded character images and their metrics.
+		/// @param[in] initial Whether this is the first attempt to write on the texture (used for internal optimization).
+		void _addCharacterImages(harray<CharacterImageContainer>& containers, bool initial);
+		/// @brief Compares character images by height for sorting.
+		/// @param[in] a First character image.
+		/// @param[in] b Second character image.
+		/// @return True if the first character image is higher.
+		static bool _compareCharacterImageHeights(CharacterImageContainer a, CharacterImageContainer b);
+		/// @brief Loads queued character images on a loader thread.
+		/// @param[in] thread The thread.
+		static void _asyncLoad(hthread* thread);
 		/// @brief Attempts to add the border character bitmap to the texture.
 		/// @param[in] charCode Character unicode value.
 		/// @param[in] borderThickness Thickness of the border.
 		/// @return True if successful.
 		/// @note Usually false is returned when the border character couldn't be or created loaded properly from the font definition.
 		bool _tryAddBorderCharacterBitmap(unsigned int charCode, float borderThickness);
+		/// @brief Creates the image of a border character depending on the border mode.
+		/// @param[in] charCode Character unicode value.
+		/// @param[in] borderThickness Thickness of the border.
+		/// @return The created image or NULL if the border character can't be created in the current border mode.
+		april::Image* _createBorderCharacterImage(unsigned int charCode, float borderThickness);
+		/// @brief Adds an already created border character image to the border textures.
+		/// @param[in] charCode Character unicode value.
+		/// @param[in] borderThickness Thickness of the border.
+		/// @param[in] image The border character image.
+		/// @return True if successful.
+		bool _addBorderCharacterImage(unsigned int charCode, float borderThickness, april::Image* image);
 		/// @brief Attempts to add the icon bitmap to the texture.
 		/// @param[in] iconName Icon name.
 		/// @param[in] initial Whether this is the first attempt to write on the texture (used for internal optimization).
@@ -159,19 +512,29 @@ namespace atres
 		/// @return True if successful.
 		/// @note Usually false is returned when the border icon couldn't be loaded or created properly from the font definition.
 		bool _tryAddBorderIconBitmap(chstr iconName, float borderThickness);
+		/// @brief Finds the least recently used texture container that can be recycled when the texture limit was reached.
+		/// @param[in] textureContainers Proper symbol type texture containers.
+		/// @return The texture container or NULL if no texture should be recycled.
+		TextureContainer* _findRecyclableTextureContainer(harray<TextureContainer*>& textureContainers);
+		/// @brief Removes all symbols from a texture container and clears its texture.
+		/// @param[in] textureContainer The texture container.
+		/// @note Cached texts that use the texture are removed from the renderer's cache.
+		void _recycleTextureContainer(TextureContainer* textureContainer);
 		/// @brief Add the symbol bitmap to the texture.
 		/// @param[in] textureContainers Proper symbol type texture containers.
 		/// @param[in] initial Whether this is the first attempt to write on the texture (used for internal optimization).
 		/// @param[in] image The symbol bitmap image.
-		/// @param[in] usedWidth The used width on the texture so far.
-		/// @param[in] usedHeight The used height on the texture so far.
+		/// @param[in] usedWidth The width of the symbol's area.
+		/// @param[in] usedHeight The height of the symbol's area.
 		/// @param[in] symbol The symbol value.
+		/// @param[out] position Position of the symbol's area on the texture.
 		/// @param[in] offsetX Horizontal offset used between symbols.
 		/// @param[in] offsetY Vertical offset used between symbols.
 		/// @param[in] safeSpace Safe space between all symbols used when rendering.
-		/// @return The texture container of the texture where the symbol bitmap was written.
+		/// @return The texture container of the texture where the symbol bitmap was written or NULL if the symbol cannot fit on any texture.
+		/// @note All existing textures are searched for free space before a new texture is created.
 		TextureContainer* _addBitmap(harray<TextureContainer*>& textureContainers, bool initial, april::Image* image, int usedWidth, int usedHeight, chstr symbol,
-			int offsetX = 0, int offsetY = 0, int safeSpace = 0);
+			gvec2i& position, int offsetX = 0, int offsetY = 0, int safeSpace = 0);
 
 		/// @brief Loads an character image.
 		/// @param[in] charCode Character unicode value.
@@ -184,6 +547,23 @@ namespace atres
 		/// @param[out] bearingX Horizontal bearing.
 		/// @return The loaded image.
 		virtual april::Image* _loadCharacterImage(unsigned int charCode, bool initial, float& advance, int& leftOffset, int& topOffset, float& ascender, float& descender, float& bearingX);
+		/// @brief Loads only the metrics of a character without creating its image.
+		/// @param[in] charCode Character unicode value.
+		/// @param[out] container The character metrics.
+		/// @param[out] imageWidth Width of the character image.
+		/// @param[out] imageHeight Height of the character image.
+		/// @return True if successful.
+		virtual bool _loadCharacterMetrics(unsigned int charCode, CharacterImageContainer& container, int& imageWidth, int& imageHeight);
+		/// @brief Prepares resources for the loader threads before they are started.
+		/// @param[in] threadCount The number of loader threads.
+		virtual void _prepareAsyncLoading(int threadCount);
+		/// @brief Loads a character image on a loader thread.
+		/// @param[in] threadIndex Index of the loader thread.
+		/// @param[in] charCode Character unicode value.
+		/// @param[out] container The loaded character image and its metrics.
+		/// @return True if successful.
+		/// @note This is not called on the main thread so it must not use any resources that the main thread or other loader threads use.
+		virtual bool _tryLoadCharacterImageAsync(int threadIndex, unsigned int charCode, CharacterImageContainer& container);
 		/// @brief Loads a border character image.
 		/// @param[in] charCode Character unicode value.
 		/// @param[in] borderThickness Thickness of the border.
@@ -194,6 +574,12 @@ namespace atres
 		/// @param[in] borderThickness Thickness of the border.
 		/// @return The loaded image.
 		virtual april::Image* _generateBorderCharacterImage(unsigned int charCode, float borderThickness);
+		/// @brief Copies an already loaded character's bitmap from the CPU-side texture copy into a new image with a transparent margin.
+		/// @param[in] charCode Character unicode value.
+		/// @param[in] borderSize Size of the transparent margin on each side.
+		/// @return The padded alpha image or NULL if the character's bitmap is not available.
+		/// @note This avoids rasterizing the character again when generating its border.
+		april::Image* _readPaddedCharacterImage(unsigned int charCode, int borderSize);
 		/// @brief Loads an icon image.
 		/// @param[in] iconName Name of the icon image to load.
 		/// @param[in] initial Whether this is the first attempt to write on the texture (used for internal optimization).
@@ -215,6 +601,56 @@ namespace atres
 		/// @param[in] borderThickness Thickness of the border.
 		/// @return A container for the structuring image.
 		StructuringImageContainer* _createStructuringImageContainer(const BorderMode& borderMode, float borderThickness);
+		/// @brief Dilates a padded alpha image to create a prerendered border.
+		/// @param[in] image The image that is dilated in place.
+		/// @param[in] borderThickness Thickness of the border.
+		/// @param[in] structuringImageContainer The structuring image for april::Image::dilate() or NULL to use the specialized kernels.
+		/// @return True if successful.
+		bool _dilateBorderImage(april::Image* image, float borderThickness, StructuringImageContainer* structuringImageContainer);
+
+		/// @brief Calculates the per-byte maximum of two buffers.
+		/// @param[out] dest The destination buffer, can be the same as one of the sources.
+		/// @param[in] a First source buffer.
+		/// @param[in] b Second source buffer.
+		/// @param[in] count Number of bytes.
+		static void _maxBytes(unsigned char* dest, const unsigned char* a, const unsigned char* b, int count);
+		/// @brief Applies a vertical maximum filter with the van Herk/Gil-Werman algorithm.
+		/// @param[in,out] data The alpha data.
+		/// @param[in] width Width of the data.
+		/// @param[in] height Height of the data.
+		/// @param[in] radius Radius of the filter window.
+		static void _dilateColumns(unsigned char* data, int width, int height, int radius);
+		/// @brief Transposes byte data.
+		/// @param[in] src The source data.
+		/// @param[out] dest The transposed data.
+		/// @param[in] width Width of the source data.
+		/// @param[in] height Height of the source data.
+		static void _transposeBytes(const unsigned char* src, unsigned char* dest, int width, int height);
+		/// @brief Dilates alpha data with a square.
+		/// @param[in,out] data The alpha data.
+		/// @param[in] width Width of the data.
+		/// @param[in] height Height of the data.
+		/// @param[in] radius Radius of the square.
+		static void _dilateSquare(unsigned char* data, int width, int height, int radius);
+		/// @brief Calculates the squared euclidean distance transform of a line.
+		/// @param[in] f Squared distances of the input, DISTANCE_INFINITY for pixels outside.
+		/// @param[out] d The calculated squared distances.
+		/// @param[in] count Number of pixels in the line.
+		/// @param[in] v Work buffer with at least count elements.
+		/// @param[in] z Work buffer with at least count + 1 elements.
+		static void _transformDistanceLine(const float* f, float* d, int count, int* v, float* z);
+		/// @brief Calculates the euclidean distance transform of an image.
+		/// @param[in,out] distances 0 for pixels to which distances are calculated, DISTANCE_INFINITY for all others.
+		/// @param[in] width Width of the image.
+		/// @param[in] height Height of the image.
+		static void _transformDistances(float* distances, int width, int height);
+		/// @brief Dilates alpha data using the distances to the symbol.
+		/// @param[in,out] data The alpha data.
+		/// @param[in] width Width of the data.
+		/// @param[in] height Height of the data.
+		/// @param[in] borderThickness Thickness of the border.
+		/// @param[in] euclidean Whether euclidean distances (circle) are used instead of city block distances (diamond).
+		static void _dilateDistance(unsigned char* data, int width, int height, float borderThickness, bool euclidean);
 
 	};
 
@@ -60,15 +60,40 @@ namespace atres
 		/// @brief Allows to turn justified text into another formatting. This is to counter languages with problematic characters.
 		HL_DEFINE_GET(Horizontal, justifiedDefault, JustifiedDefault);
 		void setJustifiedDefault(Horizontal value);
+		/// @brief When turned on, colors are baked into the vertices so all symbols and linings sharing a texture can be rendered with one render call,
+		/// regardless of their color or whether they are text, shadow or border.
+		/// @note The global alpha of the drawn text is still applied at draw time.
+		HL_DEFINE_IS(useVertexColors, UseVertexColors);
+		void setUseVertexColors(bool value);
+		/// @brief When turned on, shadows and software borders are not stored as additional vertices. Instead the text vertices are rendered again with an offset
+		/// for each effect pass which greatly reduces the amount of cached vertices.
+		/// @note Prerendered and font-native borders are not affected since they use different symbol images.
+		HL_DEFINE_IS(useEffectPasses, UseEffectPasses);
+		void setUseEffectPasses(bool value);
 		hstr getDefaultFontName() const;
 		void setDefaultFontName(chstr value);
 		void setCacheSize(int value);
+		/// @brief When turned on, drawing only queues the geometry into a frame queue which is rendered with as few render calls as possible by flush().
+		/// @note Geometry is queued with absolute coordinates so the render state (e.g. the modelview matrix) must not change between queued calls. Call flush() before changing it.
+		HL_DEFINE_IS(batching, Batching);
+		void setBatching(bool value);
+		/// @brief The number of render calls issued since the last reset.
+		/// @note Useful for measuring the benefits of batching.
+		HL_DEFINE_GET(int, drawCallCount, DrawCallCount);
+		/// @brief The number of batches rendered by the last flush().
+		HL_DEFINE_GET(int, flushedBatchCount, FlushedBatchCount);
+		void resetDrawCallCount();
+		/// @brief The current frame, advanced by every update() and flush().
+		/// @note Fonts use this to track which of their textures are in use and to add asynchronously loaded characters gradually.
+		HL_DEFINE_GET(int, frame, Frame);
 
 		bool hasFont(chstr name) const;
 
 		/// @param[in] allowDefault Allows font to be set as default if necessary
 		void registerFont(Font* font, bool allowDefault = true);
+		/// @note Renders queued batches first since they can use textures of the destroyed fonts.
 		void destroyAllFonts();
+		/// @note Renders queued batches first since they can use textures of the destroyed font.
 		void destroyFont(Font* font);
 		void unregisterFont(Font* font);
 		void registerFontAlias(chstr name, chstr alias);
@@ -86,6 +111,7 @@ namespace atres
 		RenderText createRenderText(cgrectf rect, chstr text, const harray<RenderLine>& lines, const harray<FormatTag>& tags);
 		harray<RenderSequence> optimizeSequences(harray<RenderSequence>& sequences);
 		harray<RenderLiningSequence> optimizeSequences(harray<RenderLiningSequence>& sequences);
+		harray<RenderColoredSequence> createColoredSequences(const RenderText& renderText);
 
 		void drawText(chstr fontName, cgrectf rect, chstr text, Horizontal horizontal = Horizontal::Left,
 			Vertical vertical = Vertical::Center, const april::Color& color = april::Color::White, cgvec2f offset = gvec2f());
@@ -134,6 +160,24 @@ namespace atres
 		hstr getFittingTextUnformatted(chstr text, float maxWidth);
 
 		void clearCache();
+		/// @brief Removes all cached texts that use the given texture.
+		/// @param[in] texture The texture.
+		/// @note Fonts call this when symbols are removed from a texture so that affected texts are created again.
+		void clearCache(april::Texture* texture);
+		/// @brief Removes all cached texts that contain characters whose images were not loaded yet.
+		/// @note Fonts that load characters asynchronously call this when the loaded characters were added to their textures.
+		void clearPendingCache();
+		/// @brief Makes the renderer check again which fonts need to know which of their textures are used.
+		/// @note Fonts call this when the result of Font::isTextureUsageTracked() can change.
+		void updateTextureUsageTracking();
+		/// @brief Ends the current frame.
+		/// @note Texture recycling, border thickness limits, atlas pools, size buckets and asynchronous loading of fonts depend on frames.
+		/// @note Should be called once at the end of every frame when flush() isn't used, flush() already calls this.
+		void update();
+		/// @brief Renders all queued batches when batching is turned on and ends the current frame.
+		/// @note Should be called once at the end of every frame and before the render state is changed.
+		/// @note Without batching there is nothing to render, but this still ends the frame, see update().
+		void flush();
 
 	protected:
 		hmap<hstr, Font*> fonts;
@@ -148,6 +192,12 @@ namespace atres
 		bool useLegacyLineBreakParsing;
 		bool useIdeographWords;
 		Horizontal justifiedDefault;
+		bool useVertexColors;
+		bool useEffectPasses;
+		bool batching;
+		int drawCallCount;
+		int flushedBatchCount;
+		int frame;
 		Cache<CacheEntryText>* cacheText;
 		Cache<CacheEntryText>* cacheTextUnformatted;
 		Cache<CacheEntryLines>* cacheLines;
@@ -160,15 +210,29 @@ namespace atres
 		void _initializeRenderSequences();
 		void _checkFormatTags(chstr text, int index);
 		void _processFormatTags(chstr text, int index);
+		void _loadBorderCharacters(const harray<RenderLine>& lines, const harray<FormatTag>& tags);
 		void _checkSequenceSwitch();
+		void _checkEffectSequenceSwitch(TextEffect effect);
+		void _checkRenderSequenceSwitch(RenderSequence& sequence, harray<RenderSequence>& sequences, april::Texture* texture, int channel);
 		void _updateLiningSequenceSwitch(bool force = false);
+		bool _findWhiteTexel(april::Texture* texture, gvec2f& uv);
+		void _mergeLiningSequences(harray<RenderSequence>& sequences, harray<RenderLiningSequence>& liningSequences);
 		bool _checkTextures();
+		void _uploadTextures();
+		void _markTexturesUsed(const RenderText& renderText);
+		void _markTextureUsed(april::Texture* texture);
 		harray<FormatTag> _makeDefaultTags(const april::Color& color, chstr fontName, hstr& text);
 		harray<FormatTag> _makeDefaultTagsUnformatted(const april::Color& color, chstr fontName);
 
 		void _drawRenderText(RenderText& renderText, const april::Color& color);
-		void _drawRenderSequence(RenderSequence& sequence, const april::Color& color);
-		void _drawRenderLiningSequence(RenderLiningSequence& sequence, const april::Color& color);
+		void _drawRenderSequence(RenderSequence& sequence, const april::Color& color, int layer = 0);
+		void _drawRenderLiningSequence(RenderLiningSequence& sequence, const april::Color& color, int layer = 0);
+		void _drawRenderColoredSequence(RenderColoredSequence& sequence, const april::Color& color);
+		void _drawRenderSequenceEffect(RenderSequence& sequence, const april::Color& color, int layer);
+		bool _setTexture(april::Texture* texture, int channel);
+		RenderBatch* _findBatch(april::Texture* texture, int channel, const april::Color& color, int layer, cgrectf bounds, bool colored = false);
+		void _renderBatch(RenderBatch& batch);
+		void _flushBatches();
 
 	private:
 		harray<FormatTag> _tags;
@@ -180,11 +244,11 @@ namespace atres
 		Font* _font;
 		FontIconMap* _iconFont;
 		hstr _fontIconName;
-		hmap<unsigned int, CharacterDefinition*>& _characters;
-		hmap<unsigned int, CharacterDefinition*> _dummyCharacters; // required for some compilers
+		const GlyphTable* _glyphs;
+		GlyphTable _dummyGlyphs;
 		hmap<hstr, IconDefinition*>& _icons;
 		hmap<hstr, IconDefinition*> _dummyIcons; // required for some compilers
-		CharacterDefinition* _character;
+		const Glyph* _character;
 		BorderCharacterDefinition* _borderCharacter;
 		IconDefinition* _icon;
 		BorderIconDefinition* _borderIcon;
@@ -258,6 +322,12 @@ namespace atres
 		CacheEntryLines _cacheEntryLines;
 		CacheEntryLine _cacheEntryLine;
 
+		harray<RenderBatch> _batches;
+		int _batchCount;
+		april::Texture* _lastUsedTexture;
+		harray<Font*> _textureUsageFonts;
+		bool _textureUsageFontsValid;
+
 	};
 	
 	atresExport extern Renderer* renderer;
@@ -64,6 +64,11 @@ namespace atres
 	{
 	public:
 		grectf rect;
+		/// @brief Index of the texture container holding this symbol (-1 if not assigned).
+		/// @note Border definitions index the font's border texture containers.
+		int textureIndex;
+		/// @brief Color channel of a channel-packed texture holding this symbol (-1 if the symbol uses all channels).
+		int channel;
 
 		RectDefinition();
 		virtual ~RectDefinition();
@@ -84,6 +89,8 @@ namespace atres
 	public:
 		gvec2f bearing;
 		float offsetY;
+		/// @brief Whether the character's image is still being loaded asynchronously and not on a texture yet.
+		bool pending;
 
 		CharacterDefinition();
 
@@ -101,11 +108,56 @@ namespace atres
 	typedef SymbolDefinition IconDefinition;
 	typedef BorderCharacterDefinition BorderIconDefinition;
 
+	/// @brief Plain character data used during text layout, copied from a CharacterDefinition.
+	class atresExport Glyph
+	{
+	public:
+		grectf rect;
+		/// @brief Normalized texture coordinates of rect.
+		grectf uvRect;
+		gvec2f bearing;
+		float advance;
+		float offsetY;
+		april::Texture* texture;
+		/// @brief Color channel of a channel-packed texture holding the glyph (-1 if the glyph uses all channels).
+		int channel;
+		bool valid;
+		bool pending;
+
+		Glyph();
+
+	};
+
+	/// @brief Character lookup table that directly indexes the Basic Multilingual Plane in pages of 256 characters.
+	/// @note Characters outside of the Basic Multilingual Plane are kept in a sparse map.
+	class atresExport GlyphTable
+	{
+	public:
+		GlyphTable();
+		~GlyphTable();
+
+		const Glyph* get(unsigned int charCode) const;
+		Glyph* add(unsigned int charCode);
+		void remove(unsigned int charCode);
+		void clear();
+
+	protected:
+		Glyph** pages;
+		hmap<unsigned int, Glyph> sparseGlyphs;
+
+	private:
+		GlyphTable(const GlyphTable& other);
+		GlyphTable& operator=(const GlyphTable& other);
+
+	};
+
 	class atresExport RenderRectangle
 	{
 	public:
 		grectf src;
 		grectf dest;
+		/// @brief Color channel of a channel-packed texture that holds the symbol (-1 if the symbol uses all channels).
+		int channel;
 
 		RenderRectangle();
 
@@ -115,8 +167,17 @@ namespace atres
 	{
 	public:
 		april::Texture* texture;
+		/// @brief Color channel of a channel-packed texture that is sampled (-1 if all channels are sampled).
+		int channel;
 		april::Color color;
 		bool multiplyAlpha;
+		/// @brief Effect that is rendered by drawing the vertices again with an offset before the actual text.
+		TextEffect effect;
+		april::Color effectColor;
+		/// @brief Offset of the shadow effect.
+		gvec2f effectOffset;
+		/// @brief Thickness of the border effect.
+		float effectThickness;
 		harray<april::TexturedVertex> vertices;
 		
 		RenderSequence();
@@ -139,6 +200,57 @@ namespace atres
 
 	};
 
+	class atresExport RenderColoredSequence
+	{
+	public:
+		april::Texture* texture;
+		/// @brief Color channel of a channel-packed texture that is sampled (-1 if all channels are sampled).
+		int channel;
+		int pass;
+		grectf bounds;
+		harray<april::ColoredTexturedVertex> vertices;
+		harray<april::ColoredVertex> liningVertices;
+		/// @brief Base colors of all vertices before the global alpha is applied.
+		harray<april::Color> colors;
+		/// @brief How many times the global alpha is multiplied into the alpha of each vertex.
+		harray<unsigned char> alphaPowers;
+
+		RenderColoredSequence();
+
+		/// @note Not thread-safe!
+		void addVertices(const harray<april::TexturedVertex>& vertices, const april::Color& color, unsigned char alphaPower, cgrectf bounds);
+		/// @note Not thread-safe!
+		void addLiningVertices(const harray<april::PlainVertex>& vertices, const april::Color& color, unsigned char alphaPower, cgrectf bounds);
+
+	};
+
+	class atresExport RenderBatch
+	{
+	public:
+		april::Texture* texture;
+		/// @brief Color channel of a channel-packed texture that is sampled (-1 if all channels are sampled).
+		int channel;
+		april::Color color;
+		int layer;
+		bool colored;
+		grectf bounds;
+		harray<april::TexturedVertex> vertices;
+		harray<april::PlainVertex> liningVertices;
+		harray<april::ColoredTexturedVertex> coloredVertices;
+		harray<april::ColoredVertex> coloredLiningVertices;
+
+		RenderBatch();
+
+		bool isEmpty() const;
+		void reset(april::Texture* texture, int channel, const april::Color& color, int layer, bool colored);
+		bool isMergeable(april::Texture* texture, int channel, const april::Color& color, int layer, bool colored) const;
+		void addVertices(const harray<april::TexturedVertex>& vertices, cgrectf bounds);
+		void addLiningVertices(const harray<april::PlainVertex>& vertices, cgrectf bounds);
+		void addColoredVertices(const harray<april::ColoredTexturedVertex>& vertices, cgrectf bounds);
+		void addColoredLiningVertices(const harray<april::ColoredVertex>& vertices, cgrectf bounds);
+
+	};
+
 	class atresExport RenderWord
 	{
 	public:
@@ -196,9 +308,14 @@ namespace atres
 		harray<RenderLiningSequence> textLiningSequences;
 		harray<RenderLiningSequence> shadowLiningSequences;
 		harray<RenderLiningSequence> borderLiningSequences;
+		harray<RenderColoredSequence> coloredSequences;
+		/// @brief Whether the text contains characters whose images were not loaded yet.
+		bool pending;
 
 		RenderText();
 
+		bool hasTexture(april::Texture* texture) const;
+
 	};
 
 	class atresExport FormatTag
@@ -237,17 +354,77 @@ namespace atres
 	{
 	public:
 		april::Texture* texture;
+		/// @brief CPU-side copy of the texture's content where new symbols are written before they are uploaded.
+		/// @note NULL if the texture is written directly.
+		april::Image* image;
+		/// @brief Area of the image that was changed since the last upload.
+		grecti dirtyRect;
 		harray<unsigned int> characters;
 		harray<hstr> icons;
-		int penX;
-		int penY;
-		int rowHeight;
+		/// @brief Solid white area on the texture that can be used for rendering untextured geometry such as linings.
+		/// @note Has a size of zero if the texture has no such area.
+		grecti whiteRect;
+		/// @brief Left-most positions and heights of the used area's upper outline, ordered from left to right.
+		/// @note Each segment reaches until the next segment or the texture's right edge.
+		harray<gvec2i> skyline;
+		/// @brief Area on the texture that has been reserved for symbols.
+		int usedArea;
+		/// @brief The last renderer frame in which the texture was used.
+		int lastUsedFrame;
+		/// @brief The shared atlas page whose texture and image are used by this texture container.
+		/// @note NULL if the texture container is not on a shared atlas page.
+		/// @note Space is reserved on the page while the container only tracks the symbols of one font. The texture is not destroyed with the container.
+		TextureContainer* page;
+		/// @brief Areas that were reserved on the shared atlas page for the symbols of this texture container.
+		/// @note They are released to the page when the texture container is destroyed.
+		harray<grecti> pageRects;
+		/// @brief Areas of a shared atlas page that were released by destroyed texture containers and can be reserved again.
+		harray<grecti> freeRects;
+		/// @brief The texture container of the first channel of a channel-packed texture that owns the texture and image.
+		/// @note NULL if the texture container owns its texture or is on a shared atlas page. Otherwise every channel reserves its own space.
+		TextureContainer* owner;
+		/// @brief The color channel of a channel-packed texture that holds the symbols of this texture container (0 to 3 for red, green, blue and alpha).
+		/// @note -1 if the symbols use all channels.
+		int channel;
+		/// @brief Texture that holds only the symbols of this texture container's channel as alpha so the stock color modes can render them.
+		/// @note NULL until getChannelTexture() is used. Updated on every upload.
+		april::Texture* channelTexture;
 
 		TextureContainer();
 		virtual ~TextureContainer();
 
 		virtual TextureContainer* createNew() const;
 
+		/// @brief Finds the lowest free position on the texture where a rectangle would fit.
+		/// @param[in] width Width of the rectangle.
+		/// @param[in] height Height of the rectangle.
+		/// @param[out] position The found position.
+		/// @return True if the rectangle fits on the texture.
+		bool findPosition(int width, int height, gvec2i& position) const;
+		/// @brief Reserves a rectangle on the texture.
+		/// @param[in] rect The rectangle.
+		/// @note The rectangle's position should be one found with findPosition().
+		void reserve(cgrecti rect);
+		/// @brief Adds an area to the area that has to be uploaded.
+		/// @param[in] rect The changed area.
+		void addDirtyRect(cgrecti rect);
+		/// @brief Uploads the changed area of the image to the texture.
+		/// @return True if anything was uploaded.
+		/// @note Also updates the changed area of the channel texture if there is one.
+		bool upload();
+		/// @brief Gets the texture that holds only the symbols of this texture container's channel as alpha.
+		/// @return The channel texture or NULL if the texture container isn't on a channel-packed texture.
+		/// @note The channel texture is created on the first call.
+		april::Texture* getChannelTexture();
+		/// @brief Destroys the channel texture, e.g. when the texture is replaced.
+		void destroyChannelTexture();
+		/// @brief Frees the entire texture area for reuse.
+		/// @note Does not clear the texture itself.
+		void resetArea();
+		/// @brief Gets the ratio of the reserved area to the texture size.
+		/// @return The ratio of the reserved area to the texture size.
+		float getOccupancy() const;
+
 	};
 
 	class atresExport BorderTextureContainer : public TextureContainer
@@ -261,6 +438,29 @@ namespace atres
 
 	};
 
+	/// @brief Texture pages that several dynamic fonts place their symbols on.
+	/// @note Has to be destroyed after all fonts that use it.
+	/// @note Space on the pages is reclaimed when a font is destroyed or evicts a border thickness, not when single symbols are recycled.
+	class atresExport TextureAtlasPool
+	{
+	public:
+		/// @brief Size of the pages.
+		int textureSize;
+		/// @brief The shared pages.
+		harray<TextureContainer*> textureContainers;
+
+		TextureAtlasPool(int textureSize);
+		~TextureAtlasPool();
+
+		/// @brief Gets the textures of all pages.
+		/// @return The textures of all pages.
+		harray<april::Texture*> getTextures() const;
+		/// @brief Gets the ratio of the reserved area to the size of all pages.
+		/// @return The ratio of the reserved area to the size of all pages.
+		float getOccupancy() const;
+
+	};
+
 	class CacheEntryBasicText
 	{
 	public:
@@ -33,6 +33,13 @@ namespace atres
 	/// @brief Sets texture size for font textures.
 	/// @param[in] value The texture size.
 	atresFnExport void setTextureSize(const int& value);
+	/// @brief Gets the size new font textures start with.
+	/// @return The initial texture size.
+	atresFnExport int getMinTextureSize();
+	/// @brief Sets the size new font textures start with.
+	/// @param[in] value The initial texture size.
+	/// @note Textures double their size when they are full until they reach the texture size. A value of 0 or less creates textures with the full size right away.
+	atresFnExport void setMinTextureSize(const int& value);
 	/// @brief Gets whether font texture can use alpha-textures.
 	/// @return True if alpha-textures can be used.
 	atresFnExport bool isAllowAlphaTextures();
@@ -40,6 +47,14 @@ namespace atres
 	/// @param[in] value Whether alpha-textures can be used.
 	/// @note Useful for VRAM conservation, but not supported on some GPU drivers (depending on platform).
 	atresFnExport void setAllowAlphaTextures(const bool& value);
+	/// @brief Gets the step to which border thicknesses are quantized.
+	/// @return The quantization step.
+	atresFnExport float getBorderThicknessStep();
+	/// @brief Sets the step to which border thicknesses are quantized.
+	/// @param[in] value The quantization step.
+	/// @note Border symbols are created once per quantized thickness. A bigger step limits the number of border textures when the border thickness is animated.
+	/// @note Should be set before any border symbols are created.
+	atresFnExport void setBorderThicknessStep(const float& value);
 
 }
 #endif
@@ -20,6 +20,11 @@
 #include "atres.h"
 #include "atresExport.h"
 
+namespace april
+{
+	class Texture;
+}
+
 namespace atres
 {
 	/// @brief Special object that caches calculated text entries.
@@ -96,6 +101,45 @@ namespace atres
 				this->entries.remove(entry);
 			}
 		}
+		/// @brief Removes all cache entries with a value that uses the given texture.
+		/// @param[in] texture The texture.
+		/// @return The number of removed cache entries.
+		/// @note Only usable with entries whose value implements hasTexture().
+		inline int removeEntries(april::Texture* texture)
+		{
+			hlist<T> removed;
+			for (list_iterator_t it = this->entries.begin(); it != this->entries.end(); ++it)
+			{
+				if ((*it).value.hasTexture(texture))
+				{
+					removed += (*it);
+				}
+			}
+			for (list_iterator_t it = removed.begin(); it != removed.end(); ++it)
+			{
+				this->removeEntry(*it);
+			}
+			return removed.size();
+		}
+		/// @brief Removes all cache entries with a value that is still pending.
+		/// @return The number of removed cache entries.
+		/// @note Only usable with entries whose value has a pending member.
+		inline int removePendingEntries()
+		{
+			hlist<T> removed;
+			for (list_iterator_t it = this->entries.begin(); it != this->entries.end(); ++it)
+			{
+				if ((*it).value.pending)
+				{
+					removed += (*it);
+				}
+			}
+			for (list_iterator_t it = removed.begin(); it != removed.end(); ++it)
+			{
+				this->removeEntry(*it);
+			}
+			return removed.size();
+		}
 		/// @brief Clears cache.
 		inline void clear()
 		{
@@ -15,9 +15,9 @@
 #include <hltypes/hltypesUtil.h>
 #include <hltypes/hstring.h>
 
+#include "atres.h"
 #include "Font.h"
-
-#define THICKNESS_TOLERANCE 0.01f
+#include "Renderer.h"
 
 namespace atres
 {
@@ -30,6 +30,14 @@ namespace atres
 		HL_ENUM_DEFINE(Font::BorderMode, PrerenderDiamond);
 	));
 
+	// using static definitions to avoid memory allocation for optimization, NOT THREAD-SAFE
+	static RenderRectangle _result;
+	static gvec2f _fullSize(1.0f, 1.0f);
+	static gvec2f _leftTop;
+	static gvec2f _rightBottom;
+	static gvec2f _textureInvertedSize;
+	static april::Texture* _texture = NULL;
+
 	Font::BorderMode Font::defaultBorderMode = Font::BorderMode::Software;
 
 	Font::Font(chstr name) :
@@ -54,34 +62,16 @@ namespace atres
 		{
 			delete it->second;
 		}
-		foreach_map (unsigned int, harray<BorderCharacterDefinition*>, it, this->borderCharacters)
-		{
-			foreach (BorderCharacterDefinition*, it2, it->second)
-			{
-				delete (*it2);
-			}
-		}
 		foreach_map (hstr, IconDefinition*, it, this->icons)
 		{
 			delete it->second;
 		}
-		foreach_map (hstr, harray<BorderIconDefinition*>, it, this->borderIcons)
-		{
-			foreach (BorderIconDefinition*, it2, it->second)
-			{
-				delete (*it2);
-			}
-		}
 		foreach (TextureContainer*, it, this->textureContainers)
 		{
 			delete (*it);
 		}
 		this->textureContainers.clear();
-		foreach (BorderTextureContainer*, it, this->borderTextureContainers)
-		{
-			delete (*it);
-		}
-		this->borderTextureContainers.clear();
+		this->_destroyBorderSymbols();
 	}
 
 	bool Font::load()
@@ -158,6 +148,12 @@ namespace atres
 		return (this->scale * this->baseScale);
 	}
 	
+	Font* Font::getScaledFont(float scale)
+	{
+		this->scale = scale;
+		return this;
+	}
+
 	float Font::getLineHeight() const
 	{
 		return (this->lineHeight * this->scale * this->baseScale);
@@ -198,22 +194,176 @@ namespace atres
 		if (this->borderMode != value)
 		{
 			this->borderMode = value;
-			foreach (BorderTextureContainer*, it, this->borderTextureContainers)
+			// border definitions reference the border texture containers by index so they have to be discarded as well
+			this->_destroyBorderSymbols();
+		}
+	}
+
+	int Font::_getCurrentFrame()
+	{
+		return (atres::renderer != NULL ? atres::renderer->getFrame() : 0);
+	}
+
+	void Font::_updateTextureUsageTracking()
+	{
+		if (atres::renderer != NULL)
+		{
+			atres::renderer->updateTextureUsageTracking();
+		}
+	}
+
+	void Font::_updateGlyph(unsigned int charCode)
+	{
+		CharacterDefinition* character = this->characters.tryGet(charCode, NULL);
+		if (character == NULL)
+		{
+			this->glyphs.remove(charCode);
+			return;
+		}
+		Glyph* glyph = this->glyphs.add(charCode);
+		glyph->rect = character->rect;
+		glyph->bearing = character->bearing;
+		glyph->advance = character->advance;
+		glyph->offsetY = character->offsetY;
+		glyph->pending = character->pending;
+		glyph->channel = character->channel;
+		glyph->texture = Font::getTexture(charCode); // not using the virtual call since the character is already loaded
+		glyph->uvRect.set(0.0f, 0.0f, 0.0f, 0.0f);
+		if (glyph->texture != NULL && glyph->texture->getWidth() > 0 && glyph->texture->getHeight() > 0)
+		{
+			_textureInvertedSize.set(1.0f / glyph->texture->getWidth(), 1.0f / glyph->texture->getHeight());
+			glyph->uvRect.setPosition(character->rect.getPosition() * _textureInvertedSize);
+			glyph->uvRect.setSize(character->rect.getSize() * _textureInvertedSize);
+		}
+	}
+
+	void Font::_destroyBorderSymbols()
+	{
+		for (hmap<int, hmap<unsigned int, BorderCharacterDefinition*> >::iterator it = this->borderCharacters.begin(); it != this->borderCharacters.end(); ++it)
+		{
+			foreach_map (unsigned int, BorderCharacterDefinition*, it2, it->second)
+			{
+				delete it2->second;
+			}
+		}
+		this->borderCharacters.clear();
+		for (hmap<int, hmap<hstr, BorderIconDefinition*> >::iterator it = this->borderIcons.begin(); it != this->borderIcons.end(); ++it)
+		{
+			foreach_map (hstr, BorderIconDefinition*, it2, it->second)
 			{
-				delete (*it);
+				delete it2->second;
 			}
-			this->borderTextureContainers.clear();
 		}
+		this->borderIcons.clear();
+		foreach (BorderTextureContainer*, it, this->borderTextureContainers)
+		{
+			delete (*it);
+		}
+		this->borderTextureContainers.clear();
+		this->thicknessBorderTextureContainers.clear();
 	}
 
 	harray<april::Texture*> Font::getTextures() const
 	{
 		HL_LAMBDA_CLASS(_containerTextures, april::Texture*, ((TextureContainer* const& container) { return container->texture; }));
-		return (this->textureContainers + this->borderTextureContainers.cast<TextureContainer*>()).mapped(&_containerTextures::lambda);
+		// the channels of a channel-packed texture use the same texture
+		return (this->textureContainers + this->borderTextureContainers.cast<TextureContainer*>()).mapped(&_containerTextures::lambda).removedDuplicates();
 	}
 	
+	int Font::uploadTextures()
+	{
+		return 0;
+	}
+
+	bool Font::markTextureUsed(april::Texture* texture)
+	{
+		int frame = Font::_getCurrentFrame();
+		bool result = false;
+		// all channels of a channel-packed texture have to be marked
+		foreach (TextureContainer*, it, this->textureContainers)
+		{
+			if ((*it)->texture == texture)
+			{
+				(*it)->lastUsedFrame = frame;
+				result = true;
+			}
+		}
+		foreach (BorderTextureContainer*, it, this->borderTextureContainers)
+		{
+			if ((*it)->texture == texture)
+			{
+				(*it)->lastUsedFrame = frame;
+				result = true;
+			}
+		}
+		return result;
+	}
+
+	bool Font::isTextureUsageTracked() const
+	{
+		return false;
+	}
+
+	bool Font::findWhiteTexel(april::Texture* texture, gvec2f& uv) const
+	{
+		if (texture == NULL)
+		{
+			return false;
+		}
+		foreachc (TextureContainer*, it, this->textureContainers)
+		{
+			if ((*it)->texture == texture && (*it)->whiteRect.w > 0 && (*it)->whiteRect.h > 0)
+			{
+				uv.set((float)(*it)->whiteRect.getCenter().x / texture->getWidth(), (float)(*it)->whiteRect.getCenter().y / texture->getHeight());
+				return true;
+			}
+		}
+		foreachc (BorderTextureContainer*, it, this->borderTextureContainers)
+		{
+			if ((*it)->texture == texture && (*it)->whiteRect.w > 0 && (*it)->whiteRect.h > 0)
+			{
+				uv.set((float)(*it)->whiteRect.getCenter().x / texture->getWidth(), (float)(*it)->whiteRect.getCenter().y / texture->getHeight());
+				return true;
+			}
+		}
+		return false;
+	}
+
+	april::Texture* Font::getChannelTexture(april::Texture* texture, int channel)
+	{
+		if (texture == NULL || channel < 0)
+		{
+			return NULL;
+		}
+		foreach (TextureContainer*, it, this->textureContainers)
+		{
+			if ((*it)->texture == texture && (*it)->channel == channel)
+			{
+				return (*it)->getChannelTexture();
+			}
+		}
+		foreach (BorderTextureContainer*, it, this->borderTextureContainers)
+		{
+			if ((*it)->texture == texture && (*it)->channel == channel)
+			{
+				return (*it)->getChannelTexture();
+			}
+		}
+		return NULL;
+	}
+
 	april::Texture* Font::getTexture(unsigned int charCode)
 	{
+		CharacterDefinition* character = this->characters.tryGet(charCode, NULL);
+		if (character == NULL)
+		{
+			return NULL;
+		}
+		if (character->textureIndex >= 0 && character->textureIndex < this->textureContainers.size())
+		{
+			this->textureContainers[character->textureIndex]->lastUsedFrame = Font::_getCurrentFrame();
+			return this->textureContainers[character->textureIndex]->texture;
+		}
 		foreachc (TextureContainer*, it, this->textureContainers)
 		{
 			if ((*it)->characters.has(charCode))
@@ -226,11 +376,25 @@ namespace atres
 
 	april::Texture* Font::getBorderTexture(unsigned int charCode, float borderThickness)
 	{
-		foreachc (BorderTextureContainer*, it, this->borderTextureContainers)
+		BorderCharacterDefinition* borderCharacter = this->getBorderCharacter(charCode, borderThickness);
+		if (borderCharacter == NULL)
+		{
+			return NULL;
+		}
+		if (borderCharacter->textureIndex >= 0 && borderCharacter->textureIndex < this->borderTextureContainers.size())
+		{
+			this->borderTextureContainers[borderCharacter->textureIndex]->lastUsedFrame = Font::_getCurrentFrame();
+			return this->borderTextureContainers[borderCharacter->textureIndex]->texture;
+		}
+		const harray<TextureContainer*>* textureContainers = this->_findBorderTextureContainers(borderThickness);
+		if (textureContainers != NULL)
 		{
-			if (heqf((*it)->borderThickness, borderThickness, THICKNESS_TOLERANCE) && (*it)->characters.has(charCode))
+			foreachc (TextureContainer*, it, (*textureContainers))
 			{
-				return (*it)->texture;
+				if ((*it)->characters.has(charCode))
+				{
+					return (*it)->texture;
+				}
 			}
 		}
 		return NULL;
@@ -238,6 +402,16 @@ namespace atres
 
 	april::Texture* Font::getTexture(chstr iconName)
 	{
+		IconDefinition* icon = this->icons.tryGet(iconName, NULL);
+		if (icon == NULL)
+		{
+			return NULL;
+		}
+		if (icon->textureIndex >= 0 && icon->textureIndex < this->textureContainers.size())
+		{
+			this->textureContainers[icon->textureIndex]->lastUsedFrame = Font::_getCurrentFrame();
+			return this->textureContainers[icon->textureIndex]->texture;
+		}
 		foreachc (TextureContainer*, it, this->textureContainers)
 		{
 			if ((*it)->icons.has(iconName))
@@ -250,11 +424,25 @@ namespace atres
 
 	april::Texture* Font::getBorderTexture(chstr iconName, float borderThickness)
 	{
-		foreachc (BorderTextureContainer*, it, this->borderTextureContainers)
+		BorderIconDefinition* borderIcon = this->getBorderIcon(iconName, borderThickness);
+		if (borderIcon == NULL)
 		{
-			if (heqf((*it)->borderThickness, borderThickness, THICKNESS_TOLERANCE) && (*it)->icons.has(iconName))
+			return NULL;
+		}
+		if (borderIcon->textureIndex >= 0 && borderIcon->textureIndex < this->borderTextureContainers.size())
+		{
+			this->borderTextureContainers[borderIcon->textureIndex]->lastUsedFrame = Font::_getCurrentFrame();
+			return this->borderTextureContainers[borderIcon->textureIndex]->texture;
+		}
+		const harray<TextureContainer*>* textureContainers = this->_findBorderTextureContainers(borderThickness);
+		if (textureContainers != NULL)
+		{
+			foreachc (TextureContainer*, it, (*textureContainers))
 			{
-				return (*it)->texture;
+				if ((*it)->icons.has(iconName))
+				{
+					return (*it)->texture;
+				}
 			}
 		}
 		return NULL;
@@ -262,7 +450,17 @@ namespace atres
 
 	bool Font::hasCharacter(unsigned int charCode)
 	{
-		return this->characters.hasKey(charCode);
+		if (this->glyphs.get(charCode) != NULL)
+		{
+			return true;
+		}
+		// subclasses that add character definitions without updating the glyph table get their glyph here so text layout can use it
+		if (this->characters.hasKey(charCode))
+		{
+			this->_updateGlyph(charCode);
+			return true;
+		}
+		return false;
 	}
 
 	bool Font::hasBorderCharacter(unsigned int charCode, float borderThickness)
@@ -280,30 +478,34 @@ namespace atres
 		return (this->getBorderIcon(iconName, borderThickness) != NULL);
 	}
 
+	int Font::makeBorderThicknessId(float borderThickness)
+	{
+		return hround(borderThickness / atres::getBorderThicknessStep());
+	}
+
+	float Font::quantizeBorderThickness(float borderThickness)
+	{
+		return Font::makeBorderThicknessId(borderThickness) * atres::getBorderThicknessStep();
+	}
+
 	BorderCharacterDefinition* Font::getBorderCharacter(unsigned int charCode, float borderThickness)
 	{
-		harray<BorderCharacterDefinition*> definitions = this->borderCharacters[charCode];
-		foreachc (BorderCharacterDefinition*, it, definitions)
+		hmap<int, hmap<unsigned int, BorderCharacterDefinition*> >::iterator it = this->borderCharacters.find(Font::makeBorderThicknessId(borderThickness));
+		if (it == this->borderCharacters.end())
 		{
-			if (heqf((*it)->borderThickness, borderThickness, THICKNESS_TOLERANCE))
-			{
-				return (*it);
-			}
+			return NULL;
 		}
-		return NULL;
+		return it->second.tryGet(charCode, NULL);
 	}
 
 	BorderIconDefinition* Font::getBorderIcon(chstr iconName, float borderThickness)
 	{
-		harray<BorderIconDefinition*> definitions = this->borderIcons[iconName];
-		foreachc (BorderIconDefinition*, it, definitions)
+		hmap<int, hmap<hstr, BorderIconDefinition*> >::iterator it = this->borderIcons.find(Font::makeBorderThicknessId(borderThickness));
+		if (it == this->borderIcons.end())
 		{
-			if (heqf((*it)->borderThickness, borderThickness, THICKNESS_TOLERANCE))
-			{
-				return (*it);
-			}
+			return NULL;
 		}
-		return NULL;
+		return it->second.tryGet(iconName, NULL);
 	}
 
 	float Font::getKerning(unsigned int previousCharCode, unsigned int charCode)
@@ -311,34 +513,41 @@ namespace atres
 		return 0.0f;
 	}
 
-	harray<BorderTextureContainer*> Font::_getBorderTextureContainers(float borderThickness) const
+	harray<TextureContainer*>& Font::_getBorderTextureContainers(float borderThickness)
 	{
-		harray<BorderTextureContainer*> result;
-		foreachc (BorderTextureContainer*, it, this->borderTextureContainers)
-		{
-			if (heqf((*it)->borderThickness, borderThickness, THICKNESS_TOLERANCE))
-			{
-				result += (*it);
-			}
-		}
-		return result;
+		return this->thicknessBorderTextureContainers[Font::makeBorderThicknessId(borderThickness)];
+	}
+
+	const harray<TextureContainer*>* Font::_findBorderTextureContainers(float borderThickness) const
+	{
+		hmap<int, harray<TextureContainer*> >::const_iterator it = this->thicknessBorderTextureContainers.find(Font::makeBorderThicknessId(borderThickness));
+		return (it != this->thicknessBorderTextureContainers.end() ? &it->second : NULL);
 	}
 
 	void Font::loadBasicAsciiCharacters()
 	{
 	}
 
+	void Font::loadCharacters(const harray<unsigned int>& charCodes)
+	{
+		foreachc (unsigned int, it, charCodes)
+		{
+			this->hasCharacter(*it);
+		}
+	}
+
 	void Font::loadBasicAsciiBorderCharacters(float borderThickness)
 	{
 	}
 
-	// using static definitions to avoid memory allocation for optimization, NOT THREAD-SAFE
-	static RenderRectangle _result;
-	static gvec2f _fullSize(1.0f, 1.0f);
-	static gvec2f _leftTop;
-	static gvec2f _rightBottom;
-	static gvec2f _textureInvertedSize;
-	static april::Texture* _texture = NULL;
+	void Font::loadBorderCharacters(const harray<unsigned int>& charCodes, float borderThickness)
+	{
+		foreachc (unsigned int, it, charCodes)
+		{
+			this->hasBorderCharacter((*it), borderThickness);
+		}
+	}
+
 
 	void Font::_applyCutoff(cgrectf rect, cgrectf area, cgrectf symbolRect, float offsetY) const
 	{
@@ -356,16 +565,37 @@ namespace atres
 		_result.src.setSize((symbolRect.getSize() * (_leftTop + _rightBottom - _fullSize)) * _textureInvertedSize);
 	}
 
+	void Font::_applyUvCutoff(cgrectf rect, cgrectf area, cgrectf uvRect) const
+	{
+		// same as _applyCutoff(), but the source is already normalized
+		_leftTop.x = (area.left() < rect.left() ? (area.right() - rect.left()) / area.w : _fullSize.x);
+		_leftTop.y = (area.top() < rect.top() ? (area.bottom() - rect.top()) / area.h : _fullSize.y);
+		_rightBottom.x = (rect.right() < area.right() ? (rect.right() - area.left()) / area.w : _fullSize.x);
+		_rightBottom.y = (rect.bottom() < area.bottom() ? (rect.bottom() - area.top()) / area.h : _fullSize.y);
+		_result.dest.setPosition(area.getPosition() + area.getSize() * (_fullSize - _leftTop));
+		_result.dest.setSize(area.getSize() * (_leftTop + _rightBottom - _fullSize));
+		_result.src.setPosition(uvRect.getPosition() + uvRect.getSize() * (_fullSize - _leftTop));
+		_result.src.setSize(uvRect.getSize() * (_leftTop + _rightBottom - _fullSize));
+	}
+
 	RenderRectangle Font::makeRenderRectangle(cgrectf rect, cgrectf area, unsigned int charCode)
 	{
 		_result.src.set(0.0f, 0.0f, 0.0f, 0.0f);
 		_result.dest = area;
+		_result.channel = -1;
 		// if destination rectangle not entirely inside drawing area
 		if (rect.intersects(_result.dest))
 		{
-			_texture = this->getTexture(charCode);
-			_textureInvertedSize.set(1.0f / _texture->getWidth(), 1.0f / _texture->getHeight());
-			this->_applyCutoff(rect, area, this->characters[charCode]->rect);
+			const Glyph* glyph = this->glyphs.get(charCode);
+			if (glyph == NULL && this->getTexture(charCode) != NULL) // makes sure the character is loaded
+			{
+				glyph = this->glyphs.get(charCode);
+			}
+			if (glyph != NULL)
+			{
+				this->_applyUvCutoff(rect, area, glyph->uvRect);
+				_result.channel = glyph->channel;
+			}
 		}
 		return _result;
 	}
@@ -374,12 +604,15 @@ namespace atres
 	{
 		_result.src.set(0.0f, 0.0f, 0.0f, 0.0f);
 		_result.dest = area;
+		_result.channel = -1;
 		// if destination rectangle not entirely inside drawing area
 		if (rect.intersects(_result.dest))
 		{
 			_texture = this->getBorderTexture(charCode, borderThickness);
 			_textureInvertedSize.set(1.0f / _texture->getWidth(), 1.0f / _texture->getHeight());
-			this->_applyCutoff(rect, area, this->getBorderCharacter(charCode, borderThickness)->rect);
+			BorderCharacterDefinition* borderCharacter = this->getBorderCharacter(charCode, borderThickness);
+			this->_applyCutoff(rect, area, borderCharacter->rect);
+			_result.channel = borderCharacter->channel;
 		}
 		return _result;
 	}
@@ -388,12 +621,15 @@ namespace atres
 	{
 		_result.src.set(0.0f, 0.0f, 0.0f, 0.0f);
 		_result.dest = area;
+		_result.channel = -1;
 		// if destination rectangle not entirely inside drawing area
 		if (rect.intersects(_result.dest))
 		{
 			_texture = this->getTexture(iconName);
 			_textureInvertedSize.set(1.0f / _texture->getWidth(), 1.0f / _texture->getHeight());
-			this->_applyCutoff(rect, area, this->icons[iconName]->rect);
+			IconDefinition* icon = this->icons[iconName];
+			this->_applyCutoff(rect, area, icon->rect);
+			_result.channel = icon->channel;
 		}
 		return _result;
 	}
@@ -402,12 +638,15 @@ namespace atres
 	{
 		_result.src.set(0.0f, 0.0f, 0.0f, 0.0f);
 		_result.dest = area;
+		_result.channel = -1;
 		// if destination rectangle not entirely inside drawing area
 		if (rect.intersects(_result.dest))
 		{
 			_texture = this->getBorderTexture(iconName, borderThickness);
 			_textureInvertedSize.set(1.0f / _texture->getWidth(), 1.0f / _texture->getHeight());
-			this->_applyCutoff(rect, area, this->getBorderIcon(iconName, borderThickness)->rect);
+			BorderIconDefinition* borderIcon = this->getBorderIcon(iconName, borderThickness);
+			this->_applyCutoff(rect, area, borderIcon->rect);
+			_result.channel = borderIcon->channel;
 		}
 		return _result;
 	}
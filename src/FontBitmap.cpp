@@ -131,8 +131,10 @@ namespace atres
 				{
 					c->advance = c->rect.w;
 				}
+				c->textureIndex = textureIndex;
 				this->characters[code] = c;
 				this->textureContainers[textureIndex]->characters += code;
+				this->_updateGlyph(code);
 			}
 		}
 		return true;
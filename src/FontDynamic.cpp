@@ -6,17 +6,37 @@
 /// This program is free software; you can redistribute it and/or modify it under
 /// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
 
+#include <chrono>
+#include <math.h>
+#include <string.h>
+
+#include <april/Image.h>
 #include <april/RenderSystem.h>
 #include <april/Texture.h>
 #include <hltypes/hlog.h>
+#include <hltypes/hltypesUtil.h>
 #include <hltypes/hstring.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define ATRES_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define ATRES_SIMD_NEON
+#endif
+
 #include "atres.h"
 #include "FontDynamic.h"
+#include "Renderer.h"
 
 // don't change these anymore, these are the optimal settings proven through a variety of fonts
 #define SAFE_SPACE 2
 #define CHARACTER_SPACE 2
+// size of the solid white area used for rendering linings, big enough so linear filtering at its center samples only white texels
+#define WHITE_SIZE 4
+// alpha value from which a pixel counts as inside the symbol for distance based dilation
+#define DISTANCE_INSIDE_THRESHOLD 128
+#define DISTANCE_INFINITY 1.0e20f
 
 namespace atres
 {
@@ -32,24 +52,181 @@ namespace atres
 		delete this->image;
 	}
 
+	FontDynamic::CharacterImageContainer::CharacterImageContainer(unsigned int charCode) :
+		image(NULL),
+		advance(0.0f),
+		leftOffset(0),
+		topOffset(0),
+		ascender(0.0f),
+		descender(0.0f),
+		bearingX(0.0f)
+	{
+		this->charCode = charCode;
+	}
+
+	FontDynamic::AsyncLoaderThread::AsyncLoaderThread(FontDynamic* font, int index) :
+		hthread(&FontDynamic::_asyncLoad, "atres async loader " + hstr(index))
+	{
+		this->font = font;
+		this->index = index;
+		this->idle = false;
+	}
+
 	FontDynamic::FontDynamic(chstr name) :
-		Font(name)
+		Font(name),
+		maxTextureCount(0),
+		maxBorderThicknessCount(0),
+		atlasPool(NULL),
+		channelPacking(false),
+		recycledTextureCount(0),
+		uploadCount(0),
+		uploadTime(0),
+		uploadArea(0),
+		fastDilation(true),
+		asyncLoading(false),
+		asyncCharactersPerFrame(16),
+		loaderThreadCount(1),
+		asyncFrame(-1)
 	{
 		this->textureSize = atres::getTextureSize();
+		this->minTextureSize = atres::getMinTextureSize();
 	}
 
 	FontDynamic::FontDynamic(chstr name, int textureSize) :
-		Font(name)
+		Font(name),
+		maxTextureCount(0),
+		maxBorderThicknessCount(0),
+		atlasPool(NULL),
+		channelPacking(false),
+		recycledTextureCount(0),
+		uploadCount(0),
+		uploadTime(0),
+		uploadArea(0),
+		fastDilation(true),
+		asyncLoading(false),
+		asyncCharactersPerFrame(16),
+		loaderThreadCount(1),
+		asyncFrame(-1)
 	{
 		this->textureSize = textureSize;
+		this->minTextureSize = atres::getMinTextureSize();
 	}
 
 	FontDynamic::~FontDynamic()
 	{
+		this->_stopAsyncLoading();
+		foreach (CharacterImageContainer, it, this->asyncLoadedCharacters)
+		{
+			if ((*it).image != NULL)
+			{
+				delete (*it).image;
+			}
+		}
 		foreach (StructuringImageContainer*, it, this->structuringImageContainers)
 		{
 			delete (*it);
 		}
+		foreach_map (april::Texture*, int, it, this->retiredTextures)
+		{
+			april::rendersys->destroyTexture(it->first);
+		}
+	}
+
+	void FontDynamic::setMaxTextureCount(int value)
+	{
+		this->maxTextureCount = value;
+		Font::_updateTextureUsageTracking();
+	}
+
+	void FontDynamic::setMaxBorderThicknessCount(int value)
+	{
+		this->maxBorderThicknessCount = value;
+		Font::_updateTextureUsageTracking();
+	}
+
+	void FontDynamic::setAtlasPool(TextureAtlasPool* value)
+	{
+		if (this->atlasPool == value)
+		{
+			return;
+		}
+		if (this->textureContainers.size() > 0 || this->borderTextureContainers.size() > 0)
+		{
+			hlog::warnf(logTag, "Font '%s': cannot change the atlas pool after symbols have been loaded!", this->name.cStr());
+			return;
+		}
+		this->atlasPool = value;
+		Font::_updateTextureUsageTracking();
+	}
+
+	void FontDynamic::setChannelPacking(bool value)
+	{
+		if (this->channelPacking == value)
+		{
+			return;
+		}
+		if (this->textureContainers.size() > 0 || this->borderTextureContainers.size() > 0)
+		{
+			hlog::warnf(logTag, "Font '%s': cannot change the channel packing after symbols have been loaded!", this->name.cStr());
+			return;
+		}
+		this->channelPacking = value;
+	}
+
+	void FontDynamic::setAsyncLoading(bool value)
+	{
+		if (this->asyncLoading == value)
+		{
+			return;
+		}
+		if (value)
+		{
+			if (!this->_isAsyncLoadingSupported())
+			{
+				hlog::warnf(logTag, "Asynchronous loading is not supported in font '%s'.", this->name.cStr());
+				return;
+			}
+			this->asyncLoading = true;
+			this->_startAsyncLoading();
+			return;
+		}
+		this->asyncLoading = false;
+		this->_stopAsyncLoading();
+		// characters that haven't been loaded yet are loaded right away
+		hmutex::ScopeLock lock(&this->asyncMutex);
+		harray<CharacterImageContainer> containers = this->asyncLoadedCharacters;
+		harray<unsigned int> charCodes = this->asyncQueue;
+		this->asyncLoadedCharacters.clear();
+		this->asyncQueue.clear();
+		lock.release();
+		CharacterImageContainer container;
+		foreach (unsigned int, it, charCodes)
+		{
+			container = CharacterImageContainer(*it);
+			this->_tryLoadCharacterImage((*it), false, container);
+			containers += container;
+		}
+		this->_addAsyncLoadedCharacterImages(containers);
+	}
+
+	void FontDynamic::setLoaderThreadCount(int value)
+	{
+		value = hmax(value, 1);
+		if (this->loaderThreadCount != value)
+		{
+			this->loaderThreadCount = value;
+			if (this->asyncThreads.size() > 0)
+			{
+				this->_stopAsyncLoading();
+				this->_startAsyncLoading();
+			}
+		}
+	}
+
+	int FontDynamic::getPendingCharacterCount()
+	{
+		hmutex::ScopeLock lock(&this->asyncMutex);
+		return (this->asyncQueue.size() + this->asyncLoadedCharacters.size());
 	}
 
 	void FontDynamic::setBorderMode(const BorderMode& value)
@@ -67,24 +244,175 @@ namespace atres
 		return atres::isAllowAlphaTextures();
 	}
 
+	bool FontDynamic::_isAsyncLoadingSupported() const
+	{
+		return false;
+	}
+
 	void FontDynamic::_tryCreateFirstTextureContainer()
 	{
 		if (this->textureContainers.size() == 0)
 		{
 			TextureContainer* textureContainer = new TextureContainer();
-			textureContainer->texture = this->_createTexture();
-			this->textureContainers += textureContainer;
+			if (this->atlasPool != NULL)
+			{
+				// without a page the containers are created by _reserveAtlasPoolArea() once a page can be created
+				if (this->_attachAtlasPoolPage(textureContainer, NULL))
+				{
+					this->textureContainers += textureContainer;
+				}
+				else
+				{
+					delete textureContainer;
+				}
+			}
+			else
+			{
+				this->_addTextureContainer(this->textureContainers, textureContainer);
+			}
 		}
 	}
 
 	void FontDynamic::_tryCreateFirstBorderTextureContainer(float borderThickness)
 	{
-		harray<BorderTextureContainer*> borderTextureContainers = this->_getBorderTextureContainers(borderThickness);
-		if (borderTextureContainers.size() == 0)
+		if (this->thicknessBorderTextureContainers.tryGet(Font::makeBorderThicknessId(borderThickness), harray<TextureContainer*>()).size() > 0)
+		{
+			return;
+		}
+		// a new border thickness can replace the least recently used one
+		if (this->maxBorderThicknessCount > 0 && this->getBorderThicknessCount() >= this->maxBorderThicknessCount)
+		{
+			int borderThicknessId = 0;
+			if (this->_findEvictableBorderThicknessId(borderThicknessId))
+			{
+				this->_evictBorderThickness(borderThicknessId);
+			}
+		}
+		BorderTextureContainer* textureContainer = new BorderTextureContainer(Font::quantizeBorderThickness(borderThickness));
+		if (this->atlasPool != NULL && !this->_attachAtlasPoolPage(textureContainer, NULL))
+		{
+			delete textureContainer;
+			return;
+		}
+		harray<TextureContainer*>& textureContainers = this->_getBorderTextureContainers(borderThickness);
+		if (this->atlasPool != NULL)
+		{
+			textureContainers += textureContainer;
+		}
+		else
+		{
+			this->_addTextureContainer(textureContainers, textureContainer);
+		}
+		this->borderTextureContainers += textureContainers.cast<BorderTextureContainer*>();
+	}
+
+	int FontDynamic::getBorderThicknessCount() const
+	{
+		int result = 0;
+		for (hmap<int, harray<TextureContainer*> >::const_iterator it = this->thicknessBorderTextureContainers.begin(); it != this->thicknessBorderTextureContainers.end(); ++it)
+		{
+			if (it->second.size() > 0)
+			{
+				++result;
+			}
+		}
+		return result;
+	}
+
+	bool FontDynamic::_findEvictableBorderThicknessId(int& borderThicknessId) const
+	{
+		int frame = Font::_getCurrentFrame();
+		int oldestFrame = frame;
+		int lastUsedFrame = 0;
+		bool found = false;
+		for (hmap<int, harray<TextureContainer*> >::const_iterator it = this->thicknessBorderTextureContainers.begin(); it != this->thicknessBorderTextureContainers.end(); ++it)
+		{
+			if (it->second.size() == 0)
+			{
+				continue;
+			}
+			lastUsedFrame = it->second.first()->lastUsedFrame;
+			foreachc (TextureContainer*, it2, it->second)
+			{
+				lastUsedFrame = hmax(lastUsedFrame, (*it2)->lastUsedFrame);
+			}
+			// border thicknesses used in the current frame could still be referenced by queued or currently created geometry
+			if (lastUsedFrame < oldestFrame)
+			{
+				oldestFrame = lastUsedFrame;
+				borderThicknessId = it->first;
+				found = true;
+			}
+		}
+		return found;
+	}
+
+	void FontDynamic::_evictBorderThickness(int borderThicknessId)
+	{
+		hmap<int, harray<TextureContainer*> >::iterator it = this->thicknessBorderTextureContainers.find(borderThicknessId);
+		if (it != this->thicknessBorderTextureContainers.end())
+		{
+			hlog::debugf(logTag, "Font '%s': evicting border thickness %g with %d textures.", this->name.cStr(), borderThicknessId * atres::getBorderThicknessStep(), it->second.size());
+			foreach (TextureContainer*, it2, it->second)
+			{
+				if (atres::renderer != NULL)
+				{
+					atres::renderer->clearCache((*it2)->texture);
+				}
+				this->borderTextureContainers.remove((BorderTextureContainer*)(*it2));
+				delete (*it2);
+			}
+			this->thicknessBorderTextureContainers.erase(it);
+		}
+		hmap<int, hmap<unsigned int, BorderCharacterDefinition*> >::iterator itCharacters = this->borderCharacters.find(borderThicknessId);
+		if (itCharacters != this->borderCharacters.end())
+		{
+			for (hmap<unsigned int, BorderCharacterDefinition*>::iterator it2 = itCharacters->second.begin(); it2 != itCharacters->second.end(); ++it2)
+			{
+				delete it2->second;
+			}
+			this->borderCharacters.erase(itCharacters);
+		}
+		hmap<int, hmap<hstr, BorderIconDefinition*> >::iterator itIcons = this->borderIcons.find(borderThicknessId);
+		if (itIcons != this->borderIcons.end())
+		{
+			for (hmap<hstr, BorderIconDefinition*>::iterator it2 = itIcons->second.begin(); it2 != itIcons->second.end(); ++it2)
+			{
+				delete it2->second;
+			}
+			this->borderIcons.erase(itIcons);
+		}
+		// the remaining border textures have moved, the outer maps are only searched so no empty entries are created
+		int borderThicknessIdOther = 0;
+		BorderCharacterDefinition* borderCharacter = NULL;
+		BorderIconDefinition* borderIcon = NULL;
+		for_iter (i, 0, this->borderTextureContainers.size())
 		{
-			BorderTextureContainer* textureContainer = new BorderTextureContainer(borderThickness);
-			textureContainer->texture = this->_createTexture();
-			this->borderTextureContainers += textureContainer;
+			borderThicknessIdOther = Font::makeBorderThicknessId(this->borderTextureContainers[i]->borderThickness);
+			itCharacters = this->borderCharacters.find(borderThicknessIdOther);
+			if (itCharacters != this->borderCharacters.end())
+			{
+				foreach (unsigned int, it2, this->borderTextureContainers[i]->characters)
+				{
+					borderCharacter = itCharacters->second.tryGet((*it2), NULL);
+					if (borderCharacter != NULL)
+					{
+						borderCharacter->textureIndex = i;
+					}
+				}
+			}
+			itIcons = this->borderIcons.find(borderThicknessIdOther);
+			if (itIcons != this->borderIcons.end())
+			{
+				foreach (hstr, it2, this->borderTextureContainers[i]->icons)
+				{
+					borderIcon = itIcons->second.tryGet((*it2), NULL);
+					if (borderIcon != NULL)
+					{
+						borderIcon->textureIndex = i;
+					}
+				}
+			}
 		}
 	}
 
@@ -138,52 +466,196 @@ namespace atres
 
 	bool FontDynamic::hasCharacter(unsigned int charCode)
 	{
-		this->_tryAddCharacterBitmap(charCode);
-		return Font::hasCharacter(charCode);
+		if (this->getTexture(charCode) != NULL) // also marks the texture as used so it won't be recycled in this frame
+		{
+			return true;
+		}
+		return this->characters.hasKey(charCode); // the character could still be loading asynchronously
 	}
 
 	bool FontDynamic::hasBorderCharacter(unsigned int charCode, float borderThickness)
 	{
-		this->_tryAddBorderCharacterBitmap(charCode, borderThickness);
-		return Font::hasBorderCharacter(charCode, borderThickness);
+		return (this->getBorderTexture(charCode, borderThickness) != NULL); // also marks the texture as used so it won't be recycled in this frame
 	}
 
 	bool FontDynamic::hasIcon(chstr iconName)
 	{
-		this->_tryAddIconBitmap(iconName);
-		return Font::hasIcon(iconName);
+		return (this->getTexture(iconName) != NULL); // also marks the texture as used so it won't be recycled in this frame
 	}
 
 	bool FontDynamic::hasBorderIcon(chstr iconName, float borderThickness)
 	{
-		this->_tryAddBorderIconBitmap(iconName, borderThickness);
-		return Font::hasBorderIcon(iconName, borderThickness);
+		return (this->getBorderTexture(iconName, borderThickness) != NULL); // also marks the texture as used so it won't be recycled in this frame
 	}
 
 	void FontDynamic::loadBasicAsciiCharacters()
 	{
 		this->_tryCreateFirstTextureContainer();
+		harray<CharacterImageContainer> containers;
+		CharacterImageContainer container;
 		for_itert (unsigned int, code, 32, 128)
 		{
-			this->_tryAddCharacterBitmap(code, true);
+			if (!this->characters.hasKey(code) && this->_tryLoadCharacterImage(code, true, container))
+			{
+				containers += container;
+			}
+		}
+		this->_addCharacterImages(containers, true);
+	}
+
+	void FontDynamic::loadCharacters(const harray<unsigned int>& charCodes)
+	{
+		if (this->asyncLoading) // characters are sorted when they are added to the textures later
+		{
+			foreachc (unsigned int, it, charCodes)
+			{
+				this->_tryAddCharacterBitmap(*it);
+			}
+			return;
+		}
+		// sorted duplicates are neighbors so they are removed in a single pass
+		harray<unsigned int> sortedCharCodes = charCodes.sorted();
+		harray<unsigned int> missingCharCodes;
+		for_iter (i, 0, sortedCharCodes.size())
+		{
+			if ((i == 0 || sortedCharCodes[i] != sortedCharCodes[i - 1]) && !this->characters.hasKey(sortedCharCodes[i]))
+			{
+				missingCharCodes += sortedCharCodes[i];
+			}
+		}
+		harray<CharacterImageContainer> containers;
+		if (this->loaderThreadCount > 1 && missingCharCodes.size() > 1 && this->_isAsyncLoadingSupported())
+		{
+			this->_loadCharacterImagesParallel(missingCharCodes, containers);
+		}
+		else
+		{
+			CharacterImageContainer container;
+			foreach (unsigned int, it, missingCharCodes)
+			{
+				if (this->_tryLoadCharacterImage((*it), false, container))
+				{
+					containers += container;
+				}
+			}
+		}
+		this->_addCharacterImages(containers, false);
+	}
+
+	void FontDynamic::_loadCharacterImagesParallel(const harray<unsigned int>& charCodes, harray<CharacterImageContainer>& containers)
+	{
+		bool temporaryThreads = (this->asyncThreads.size() == 0);
+		hmutex::ScopeLock lock(&this->asyncMutex);
+		this->asyncBatchQueue += charCodes;
+		lock.release();
+		this->_startAsyncLoading(); // queued first so threads of asynchronous loading that became idle pick up the batch
+		// instead of waiting, this thread loads characters from the same queue
+		harray<CharacterImageContainer> loaded;
+		CharacterImageContainer container;
+		unsigned int charCode = 0;
+		while (true)
+		{
+			lock.acquire(&this->asyncMutex);
+			if (this->asyncBatchQueue.size() == 0)
+			{
+				lock.release();
+				break;
+			}
+			charCode = this->asyncBatchQueue.removeFirst();
+			lock.release();
+			container = CharacterImageContainer(charCode);
+			if (!this->_tryLoadCharacterImage(charCode, false, container))
+			{
+				container.image = NULL;
+			}
+			loaded += container;
+		}
+		// stopping waits for the characters that are still being loaded, threads of asynchronous loading keep running
+		if (temporaryThreads)
+		{
+			this->_stopAsyncLoading();
+		}
+		lock.acquire(&this->asyncMutex);
+		loaded += this->asyncBatchLoadedCharacters;
+		this->asyncBatchLoadedCharacters.clear();
+		lock.release();
+		while (loaded.size() < charCodes.size()) // only the last few characters on running loader threads are waited for
+		{
+			hthread::sleep(0.1f);
+			lock.acquire(&this->asyncMutex);
+			loaded += this->asyncBatchLoadedCharacters;
+			this->asyncBatchLoadedCharacters.clear();
+			lock.release();
+		}
+		// images are only added to the textures on this thread
+		foreach (CharacterImageContainer, it, loaded)
+		{
+			if ((*it).image != NULL)
+			{
+				containers += (*it);
+			}
+		}
+	}
+
+	bool FontDynamic::_compareCharacterImageHeights(CharacterImageContainer a, CharacterImageContainer b)
+	{
+		return (a.image->h > b.image->h);
+	}
+
+	void FontDynamic::_addCharacterImages(harray<CharacterImageContainer>& containers, bool initial)
+	{
+		// adding the highest images first keeps the outline of the used texture area flat which wastes less space
+		containers.sort(&FontDynamic::_compareCharacterImageHeights);
+		foreach (CharacterImageContainer, it, containers)
+		{
+			this->_addCharacterImage((*it), initial);
 		}
 	}
 
 	void FontDynamic::loadBasicAsciiBorderCharacters(float borderThickness)
 	{
 		this->_tryCreateFirstBorderTextureContainer(borderThickness);
+		harray<unsigned int> charCodes;
 		for_itert (unsigned int, code, 32, 128)
 		{
-			this->_tryAddBorderCharacterBitmap(code, true);
+			charCodes += code;
+		}
+		this->loadBorderCharacters(charCodes, borderThickness);
+	}
+
+	void FontDynamic::loadBorderCharacters(const harray<unsigned int>& charCodes, float borderThickness)
+	{
+		borderThickness = Font::quantizeBorderThickness(borderThickness); // all symbols with the same border thickness ID have to look the same
+		harray<CharacterImageContainer> containers;
+		CharacterImageContainer container;
+		// sorted duplicates are neighbors so they are skipped in a single pass
+		harray<unsigned int> sortedCharCodes = charCodes.sorted();
+		for_iter (i, 0, sortedCharCodes.size())
+		{
+			if ((i == 0 || sortedCharCodes[i] != sortedCharCodes[i - 1]) && !Font::hasBorderCharacter(sortedCharCodes[i], borderThickness))
+			{
+				container.charCode = sortedCharCodes[i];
+				container.image = this->_createBorderCharacterImage(sortedCharCodes[i], borderThickness);
+				if (container.image != NULL)
+				{
+					containers += container;
+				}
+			}
+		}
+		// adding the highest images first keeps the outline of the used texture area flat which wastes less space
+		containers.sort(&FontDynamic::_compareCharacterImageHeights);
+		foreach (CharacterImageContainer, it, containers)
+		{
+			this->_addBorderCharacterImage((*it).charCode, borderThickness, (*it).image);
 		}
 	}
 
-	april::Texture* FontDynamic::_createTexture()
+	april::Texture* FontDynamic::_createTexture(int textureSize, bool packed)
 	{
 		april::Texture* texture = NULL;
 		if (this->_isAllowAlphaTextures() && april::rendersys->getCaps().textureFormats.has(april::Image::Format::Alpha))
 		{
-			texture = april::rendersys->createTexture(this->textureSize, this->textureSize, april::Color::Clear, april::Image::Format::Alpha);
+			texture = april::rendersys->createTexture(textureSize, textureSize, april::Color::Clear, april::Image::Format::Alpha);
 			if (texture == NULL)
 			{
 				hlog::warn(logTag, "Could not create alpha texture for font, trying an RGBA format.");
@@ -191,114 +663,755 @@ namespace atres
 		}
 		if (texture == NULL)
 		{
-			texture = april::rendersys->createTexture(this->textureSize, this->textureSize, april::Color::Blank, april::rendersys->getNativeTextureFormat(april::Image::Format::RGBA));
+			// the unused channels of a channel-packed texture must not count as symbols
+			texture = april::rendersys->createTexture(textureSize, textureSize, (packed ? april::Color::Clear : april::Color::Blank),
+				april::rendersys->getNativeTextureFormat(april::Image::Format::RGBA));
 		}
 		return texture;
 	}
 
-	bool FontDynamic::_tryAddCharacterBitmap(unsigned int charCode, bool initial)
+	void FontDynamic::_initializeTextureContainer(TextureContainer* textureContainer, bool atlasPoolPage)
 	{
-		if (this->characters.hasKey(charCode))
+		if (textureContainer->texture == NULL)
 		{
-			return true;
+			// shared atlas pages always have the full size since other fonts use them as well
+			int textureSize = this->textureSize;
+			if (atlasPoolPage)
+			{
+				textureSize = this->atlasPool->textureSize;
+			}
+			else if (this->minTextureSize > 0)
+			{
+				textureSize = hmin(this->minTextureSize, this->textureSize);
+			}
+			bool packed = (this->channelPacking && !atlasPoolPage);
+			textureContainer->texture = this->_createTexture(textureSize, packed);
+			if (textureContainer->texture != NULL)
+			{
+				april::Image::Format format = textureContainer->texture->getFormat();
+				april::Color color = april::Color::Blank;
+				// channels are written separately so the CPU-side copy needs a known channel order, the upload converts it
+				if (packed && format != april::Image::Format::Alpha)
+				{
+					format = april::Image::Format::RGBA;
+					color = april::Color::Clear;
+					textureContainer->channel = 0;
+				}
+				textureContainer->image = april::Image::create(textureContainer->texture->getWidth(), textureContainer->texture->getHeight(), color, format);
+			}
 		}
-		float advance = 0.0f;
-		int leftOffset = 0;
-		int topOffset = 0;
-		float ascender = 0.0f;
-		float descender = 0.0f;
-		float bearingX = 0.0f;
-		april::Image* image = this->_loadCharacterImage(charCode, initial, advance, leftOffset, topOffset, ascender, descender, bearingX);
-		if (image == NULL)
+		else if (textureContainer->image != NULL && textureContainer->channel >= 0)
 		{
-			return false;
+			// the other channels hold the symbols of other texture containers
+			int bpp = textureContainer->image->format.getBpp();
+			int size = textureContainer->image->w * textureContainer->image->h;
+			unsigned char* data = textureContainer->image->data + textureContainer->channel;
+			for_iter (i, 0, size)
+			{
+				data[i * bpp] = 0;
+			}
+			textureContainer->addDirtyRect(grecti(0, 0, textureContainer->image->w, textureContainer->image->h));
+			textureContainer->resetArea();
 		}
-		// this makes sure that there is no vertical overlap between characters
-		int lineOffset = hceil(this->height - descender);
-		int bearingY = -hmin(lineOffset - topOffset, 0);
-		int offsetY = hmax(lineOffset - topOffset, 0);
-		int charWidth = image->w + SAFE_SPACE * 2;
-		int charHeight = image->h + SAFE_SPACE * 2;
-		// add bitmap to texture
-		this->_tryCreateFirstTextureContainer();
-		TextureContainer* textureContainer = this->_addBitmap(this->textureContainers, initial, image, charWidth, charHeight, hsprintf("character 0x%X", charCode), hmax(leftOffset, 0), 0, SAFE_SPACE);
-		// character definition
-		CharacterDefinition* character = new CharacterDefinition();
-		character->rect.set((float)textureContainer->penX, (float)textureContainer->penY, (float)charWidth, (float)charHeight);
-		character->advance = advance;
-		character->bearing.set(bearingX, lineOffset + ascender + bearingY);
-		character->offsetY = (float)offsetY;
-		this->characters[charCode] = character;
-		textureContainer->characters += charCode;
-		textureContainer->penX += charWidth + CHARACTER_SPACE * 2;
-		return true;
-	}
-
-	bool FontDynamic::_tryAddBorderCharacterBitmap(unsigned int charCode, float borderThickness)
-	{
-		if (Font::hasBorderCharacter(charCode, borderThickness)) // cannot use current class' implementation since it would cause recursion
+		else if (textureContainer->image != NULL)
 		{
-			return true;
+			textureContainer->image->fillRect(0, 0, textureContainer->image->w, textureContainer->image->h, april::Color::Blank);
+			textureContainer->addDirtyRect(grecti(0, 0, textureContainer->image->w, textureContainer->image->h));
+			textureContainer->resetArea();
 		}
-		april::Image* image = NULL;
-		if (this->borderMode == BorderMode::FontNative)
+		else
 		{
-			image = this->_loadBorderCharacterImage(charCode, borderThickness);
+			textureContainer->texture->fillRect(0, 0, textureContainer->texture->getWidth(), textureContainer->texture->getHeight(), april::Color::Blank);
+			textureContainer->resetArea();
 		}
-		else if (this->borderMode != BorderMode::Software)
+		textureContainer->lastUsedFrame = Font::_getCurrentFrame();
+		if (textureContainer->texture == NULL)
 		{
-			image = this->_generateBorderCharacterImage(charCode, borderThickness);
+			return;
 		}
-		if (image == NULL)
+		bool written = false;
+		if (textureContainer->image != NULL)
 		{
-			return false;
+			written = textureContainer->image->fillRect(0, 0, WHITE_SIZE, WHITE_SIZE, april::Color::White);
+			textureContainer->addDirtyRect(grecti(0, 0, WHITE_SIZE, WHITE_SIZE));
 		}
-		// this makes sure that there is no vertical overlap between characters
-		BorderCharacterDefinition* borderCharacter = new BorderCharacterDefinition(borderThickness);
-		int charWidth = image->w + SAFE_SPACE * 2;
-		int charHeight = image->h + SAFE_SPACE * 2;
-		// add bitmap to texture
-		this->_tryCreateFirstBorderTextureContainer(borderThickness);
-		harray<BorderTextureContainer*> borderTextureContainers = this->_getBorderTextureContainers(borderThickness);
-		harray<TextureContainer*> textureContainers = borderTextureContainers.cast<TextureContainer*>();
-		TextureContainer* textureContainer = this->_addBitmap(textureContainers, false, image, charWidth, charHeight, hsprintf("border-character 0x%X", charCode), 0, 0, SAFE_SPACE);
-		if (textureContainers.size() > borderTextureContainers.size())
+		else
 		{
-			this->borderTextureContainers += textureContainers(borderTextureContainers.size(), textureContainers.size() - borderTextureContainers.size()).cast<BorderTextureContainer*>();
+			written = textureContainer->texture->fillRect(0, 0, WHITE_SIZE, WHITE_SIZE, april::Color::White);
+		}
+		if (written)
+		{
+			textureContainer->whiteRect.set(0, 0, WHITE_SIZE, WHITE_SIZE);
+			textureContainer->reserve(grecti(0, 0, WHITE_SIZE + CHARACTER_SPACE * 2, WHITE_SIZE + CHARACTER_SPACE * 2));
 		}
-		// character definition
-		borderCharacter->rect.set((float)textureContainer->penX, (float)textureContainer->penY, (float)charWidth, (float)charHeight);
-		this->borderCharacters[charCode] += borderCharacter;
-		textureContainer->characters += charCode;
-		textureContainer->penX += charWidth + CHARACTER_SPACE * 2;
-		return true;
 	}
 
-	bool FontDynamic::_tryAddIconBitmap(chstr iconName, bool initial)
+	void FontDynamic::_addTextureContainer(harray<TextureContainer*>& textureContainers, TextureContainer* textureContainer)
 	{
-		if (this->icons.hasKey(iconName))
+		this->_initializeTextureContainer(textureContainer);
+		if (textureContainer->channel != 0)
 		{
-			return true;
+			textureContainers += textureContainer;
+			return;
 		}
-		float advance = 0.0f;
-		april::Image* image = this->_loadIconImage(iconName, initial, advance);
-		if (image == NULL)
+		// the per-channel textures the renderer samples from can use more memory than packing saves which is easy to miss
+		bool packed = false;
+		foreach (TextureContainer*, it, this->textureContainers)
 		{
-			return false;
+			if ((*it)->channel >= 0)
+			{
+				packed = true;
+				break;
+			}
 		}
-		// this makes sure that there is no vertical overlap between icons
+		foreach (BorderTextureContainer*, it, this->borderTextureContainers)
+		{
+			if ((*it)->channel >= 0)
+			{
+				packed = true;
+				break;
+			}
+		}
+		if (!packed)
+		{
+			hlog::warnf(logTag, "Font '%s': symbols are packed into color channels, the renderer samples them through an additional texture per channel!",
+				this->name.cStr());
+		}
+		textureContainers += textureContainer;
+		TextureContainer* plane = NULL;
+		for_iter (i, 1, 4)
+		{
+			plane = textureContainer->createNew();
+			plane->owner = textureContainer;
+			plane->channel = i;
+			plane->texture = textureContainer->texture;
+			plane->image = textureContainer->image;
+			plane->lastUsedFrame = textureContainer->lastUsedFrame;
+			// the solid white area is written on all channels
+			plane->whiteRect = textureContainer->whiteRect;
+			if (plane->whiteRect.w > 0 && plane->whiteRect.h > 0)
+			{
+				plane->reserve(grecti(0, 0, WHITE_SIZE + CHARACTER_SPACE * 2, WHITE_SIZE + CHARACTER_SPACE * 2));
+			}
+			textureContainers += plane;
+		}
+	}
+
+	bool FontDynamic::_writeImageChannel(april::Image* dest, int x, int y, int channel, april::Image* image)
+	{
+		int bpp = dest->format.getBpp();
+		if (channel < 0 || channel >= bpp || x < 0 || y < 0 || x + image->w > dest->w || y + image->h > dest->h)
+		{
+			return false;
+		}
+		april::Image* alphaImage = image;
+		if (image->format.getBpp() != 1)
+		{
+			alphaImage = image->extractAlpha();
+			if (alphaImage == NULL)
+			{
+				return false;
+			}
+		}
+		const unsigned char* src = alphaImage->data;
+		unsigned char* row = NULL;
+		for_iter (j, 0, alphaImage->h)
+		{
+			row = dest->data + ((y + j) * dest->w + x) * bpp + channel;
+			for_iter (i, 0, alphaImage->w)
+			{
+				row[i * bpp] = src[i];
+			}
+			src += alphaImage->w;
+		}
+		if (alphaImage != image)
+		{
+			delete alphaImage;
+		}
+		return true;
+	}
+
+	bool FontDynamic::_growTextureContainer(TextureContainer* textureContainer, int width, int height, gvec2i& position)
+	{
+		// all channels of a channel-packed texture grow together
+		TextureContainer* owner = (textureContainer->owner != NULL ? textureContainer->owner : textureContainer);
+		if (owner->page != NULL || owner->texture == NULL || owner->image == NULL)
+		{
+			return false;
+		}
+		int size = owner->texture->getWidth();
+		if (size >= this->textureSize || width > this->textureSize || height > this->textureSize)
+		{
+			return false;
+		}
+		// the smallest doubled size where the area fits right of the current content
+		int newSize = size * 2;
+		while (newSize < this->textureSize && (width > newSize - size || height > newSize))
+		{
+			newSize *= 2;
+		}
+		newSize = hmin(newSize, this->textureSize);
+		april::Image::Format format = owner->texture->getFormat();
+		april::Color color = (format == april::Image::Format::Alpha || owner->channel >= 0 ? april::Color::Clear : april::Color::Blank);
+		april::Texture* texture = april::rendersys->createTexture(newSize, newSize, color, format);
+		if (texture == NULL)
+		{
+			hlog::warnf(logTag, "Font '%s': could not grow texture from %d to %d.", this->name.cStr(), size, newSize);
+			return false;
+		}
+		hlog::debugf(logTag, "Font '%s': growing texture from %d to %d.", this->name.cStr(), size, newSize);
+		april::Image* image = april::Image::create(newSize, newSize, color, owner->image->format);
+		image->write(0, 0, size, size, 0, 0, owner->image);
+		delete owner->image;
+		// geometry created in this frame can still use the old texture
+		this->retiredTextures[owner->texture] = Font::_getCurrentFrame();
+		Font::_updateTextureUsageTracking();
+		if (atres::renderer != NULL)
+		{
+			atres::renderer->clearCache(owner->texture);
+		}
+		harray<TextureContainer*> planes;
+		planes += owner;
+		if (owner->channel >= 0)
+		{
+			foreach (TextureContainer*, it, this->textureContainers)
+			{
+				if ((*it)->owner == owner)
+				{
+					planes += (*it);
+				}
+			}
+			foreach (BorderTextureContainer*, it, this->borderTextureContainers)
+			{
+				if ((*it)->owner == owner)
+				{
+					planes += (*it);
+				}
+			}
+		}
+		foreach (TextureContainer*, it, planes)
+		{
+			(*it)->texture = texture;
+			(*it)->image = image;
+			(*it)->dirtyRect.set(0, 0, 0, 0);
+			// created again from the grown image when it's needed
+			(*it)->destroyChannelTexture();
+			// the new area right of the old content is free from the top
+			if ((*it)->skyline.last().y != 0)
+			{
+				(*it)->skyline += gvec2i(size, 0);
+			}
+			// glyph UVs are normalized to the texture size
+			if (dynamic_cast<BorderTextureContainer*>(*it) == NULL)
+			{
+				foreach (unsigned int, it2, (*it)->characters)
+				{
+					this->_updateGlyph(*it2);
+				}
+			}
+		}
+		owner->addDirtyRect(grecti(0, 0, size, size));
+		return textureContainer->findPosition(width, height, position);
+	}
+
+	void FontDynamic::_updateRetiredTextures()
+	{
+		int frame = Font::_getCurrentFrame();
+		harray<april::Texture*> textures = this->retiredTextures.keys();
+		// the renderer's cache was already cleared when the textures were retired, see _growTextureContainer()
+		foreach (april::Texture*, it, textures)
+		{
+			if (this->retiredTextures[*it] < frame)
+			{
+				april::rendersys->destroyTexture(*it);
+				this->retiredTextures.removeKey(*it);
+				if (this->retiredTextures.size() == 0)
+				{
+					Font::_updateTextureUsageTracking();
+				}
+			}
+		}
+	}
+
+	bool FontDynamic::_isAtlasPoolPageUsable(TextureContainer* page) const
+	{
+		return (page->texture != NULL && (this->_isAllowAlphaTextures() || page->texture->getFormat() != april::Image::Format::Alpha));
+	}
+
+	TextureContainer* FontDynamic::_createAtlasPoolPage()
+	{
+		TextureContainer* page = new TextureContainer();
+		this->_initializeTextureContainer(page, true);
+		if (page->texture == NULL)
+		{
+			delete page;
+			return NULL;
+		}
+		this->atlasPool->textureContainers += page;
+		return page;
+	}
+
+	bool FontDynamic::_attachAtlasPoolPage(TextureContainer* textureContainer, TextureContainer* page)
+	{
+		if (page == NULL) // the last usable page is used before a new one is created
+		{
+			for (int i = this->atlasPool->textureContainers.size() - 1; i >= 0; --i)
+			{
+				if (this->_isAtlasPoolPageUsable(this->atlasPool->textureContainers[i]))
+				{
+					page = this->atlasPool->textureContainers[i];
+					break;
+				}
+			}
+			if (page == NULL)
+			{
+				page = this->_createAtlasPoolPage();
+				if (page == NULL)
+				{
+					return false;
+				}
+			}
+		}
+		textureContainer->page = page;
+		textureContainer->texture = page->texture;
+		textureContainer->image = page->image;
+		textureContainer->whiteRect = page->whiteRect;
+		textureContainer->lastUsedFrame = Font::_getCurrentFrame();
+		// a new page's initial content is uploaded by the first font that uses it
+		if (page->dirtyRect.w > 0 && page->dirtyRect.h > 0)
+		{
+			textureContainer->addDirtyRect(page->dirtyRect);
+			page->dirtyRect.set(0, 0, 0, 0);
+		}
+		return true;
+	}
+
+	TextureContainer* FontDynamic::_reserveAtlasPoolArea(harray<TextureContainer*>& textureContainers, grecti& rect, chstr symbol)
+	{
+		TextureContainer* page = NULL;
+		gvec2i current;
+		// the smallest area that other fonts released is used first
+		int freeIndex = -1;
+		grecti freeRect;
+		foreach (TextureContainer*, it, this->atlasPool->textureContainers)
+		{
+			if (this->_isAtlasPoolPageUsable(*it))
+			{
+				for_iter (i, 0, (*it)->freeRects.size())
+				{
+					if ((*it)->freeRects[i].w >= rect.w && (*it)->freeRects[i].h >= rect.h && (page == NULL || (*it)->freeRects[i].w * (*it)->freeRects[i].h < freeRect.w * freeRect.h))
+					{
+						page = (*it);
+						freeIndex = i;
+						freeRect = (*it)->freeRects[i];
+					}
+				}
+			}
+		}
+		if (page != NULL)
+		{
+			page->freeRects.removeAt(freeIndex);
+			rect.setPosition(freeRect.x, freeRect.y);
+			// the rest of the released area stays available
+			if (freeRect.w > rect.w)
+			{
+				page->freeRects += grecti(freeRect.x + rect.w, freeRect.y, freeRect.w - rect.w, rect.h);
+			}
+			if (freeRect.h > rect.h)
+			{
+				page->freeRects += grecti(freeRect.x, freeRect.y + rect.h, freeRect.w, freeRect.h - rect.h);
+			}
+			page->usedArea += rect.w * rect.h;
+			// the released area still contains the previous symbols
+			if (page->image != NULL)
+			{
+				page->image->fillRect(rect.x, rect.y, rect.w, rect.h, april::Color::Blank);
+			}
+			else
+			{
+				page->texture->fillRect(rect.x, rect.y, rect.w, rect.h, april::Color::Blank);
+			}
+		}
+		else
+		{
+			// use the lowest free position on all shared pages
+			foreach (TextureContainer*, it, this->atlasPool->textureContainers)
+			{
+				if (this->_isAtlasPoolPageUsable(*it) && (*it)->findPosition(rect.w, rect.h, current) && (page == NULL || current.y < rect.y))
+				{
+					page = (*it);
+					rect.setPosition(current);
+				}
+			}
+		}
+		if (page == NULL)
+		{
+			hlog::debugf(logTag, "Font '%s': %s does not fit, creating new shared atlas page.", this->name.cStr(), symbol.cStr());
+			page = this->_createAtlasPoolPage();
+			if (page == NULL || !page->findPosition(rect.w, rect.h, current))
+			{
+				hlog::errorf(logTag, "Font '%s': %s is too big for the atlas pool texture size %d!", this->name.cStr(), symbol.cStr(), this->atlasPool->textureSize);
+				return NULL;
+			}
+			rect.setPosition(current);
+		}
+		if (freeIndex < 0)
+		{
+			page->reserve(rect);
+		}
+		TextureContainer* textureContainer = NULL;
+		foreach (TextureContainer*, it, textureContainers)
+		{
+			if ((*it)->page == page)
+			{
+				textureContainer = (*it);
+				break;
+			}
+		}
+		if (textureContainer == NULL)
+		{
+			textureContainer = (textureContainers.size() > 0 ? textureContainers.last()->createNew() : new TextureContainer());
+			this->_attachAtlasPoolPage(textureContainer, page);
+			textureContainers += textureContainer;
+		}
+		// only the font's own share of the page
+		textureContainer->usedArea += rect.w * rect.h;
+		textureContainer->pageRects += rect;
+		if (freeIndex >= 0)
+		{
+			textureContainer->addDirtyRect(rect);
+		}
+		return textureContainer;
+	}
+
+	bool FontDynamic::_tryAddCharacterBitmap(unsigned int charCode, bool initial)
+	{
+		if (this->characters.hasKey(charCode))
+		{
+			return true;
+		}
+		if (this->asyncLoading && !initial && this->_tryAddPendingCharacter(charCode))
+		{
+			return true;
+		}
+		CharacterImageContainer container(charCode);
+		if (!this->_tryLoadCharacterImage(charCode, initial, container))
+		{
+			return false;
+		}
+		return this->_addCharacterImage(container, initial);
+	}
+
+	bool FontDynamic::_tryLoadCharacterImage(unsigned int charCode, bool initial, CharacterImageContainer& container)
+	{
+		container.charCode = charCode;
+		container.image = this->_loadCharacterImage(charCode, initial, container.advance, container.leftOffset, container.topOffset, container.ascender, container.descender, container.bearingX);
+		return (container.image != NULL);
+	}
+
+	bool FontDynamic::_addCharacterImage(CharacterImageContainer& container, bool initial)
+	{
+		april::Image* image = container.image;
+		container.image = NULL; // _addBitmap() takes care of destroying the image
+		int imageWidth = image->w;
+		int imageHeight = image->h;
+		// add bitmap to texture
+		this->_tryCreateFirstTextureContainer();
+		gvec2i position;
+		TextureContainer* textureContainer = this->_addBitmap(this->textureContainers, initial, image, imageWidth + SAFE_SPACE * 2, imageHeight + SAFE_SPACE * 2,
+			hsprintf("character 0x%X", container.charCode), position, hmax(container.leftOffset, 0), 0, SAFE_SPACE);
+		CharacterDefinition* character = this->characters.tryGet(container.charCode, NULL);
+		if (textureContainer == NULL)
+		{
+			if (character != NULL) // a pending character that cannot be loaded is removed
+			{
+				delete character;
+				this->characters.removeKey(container.charCode);
+				this->_updateGlyph(container.charCode);
+			}
+			return false;
+		}
+		// character definition, a pending character keeps its definition so its advance doesn't change
+		if (character == NULL)
+		{
+			character = new CharacterDefinition();
+			this->characters[container.charCode] = character;
+		}
+		this->_updateCharacterDefinition(character, container, imageWidth, imageHeight);
+		character->rect.setPosition((float)position.x, (float)position.y);
+		character->pending = false;
+		character->textureIndex = this->textureContainers.indexOf(textureContainer);
+		character->channel = textureContainer->channel;
+		textureContainer->characters += container.charCode;
+		this->_updateGlyph(container.charCode);
+		return true;
+	}
+
+	void FontDynamic::_updateCharacterDefinition(CharacterDefinition* character, const CharacterImageContainer& container, int imageWidth, int imageHeight)
+	{
+		// this makes sure that there is no vertical overlap between characters
+		int lineOffset = hceil(this->height - container.descender);
+		int bearingY = -hmin(lineOffset - container.topOffset, 0);
+		character->rect.setSize((float)(imageWidth + SAFE_SPACE * 2), (float)(imageHeight + SAFE_SPACE * 2));
+		character->advance = container.advance;
+		character->bearing.set(container.bearingX, lineOffset + container.ascender + bearingY);
+		character->offsetY = (float)hmax(lineOffset - container.topOffset, 0);
+	}
+
+	bool FontDynamic::_tryAddPendingCharacter(unsigned int charCode)
+	{
+		CharacterImageContainer container(charCode);
+		int imageWidth = 0;
+		int imageHeight = 0;
+		if (!this->_loadCharacterMetrics(charCode, container, imageWidth, imageHeight))
+		{
+			return false;
+		}
+		CharacterDefinition* character = new CharacterDefinition();
+		this->_updateCharacterDefinition(character, container, imageWidth, imageHeight);
+		character->pending = true;
+		this->characters[charCode] = character;
+		this->_updateGlyph(charCode);
+		hmutex::ScopeLock lock(&this->asyncMutex);
+		this->asyncQueue += charCode;
+		lock.release();
+		this->_startAsyncLoading();
+		return true;
+	}
+
+	void FontDynamic::_asyncLoad(hthread* thread)
+	{
+		AsyncLoaderThread* loaderThread = (AsyncLoaderThread*)thread;
+		FontDynamic* font = loaderThread->font;
+		CharacterImageContainer container;
+		unsigned int charCode = 0;
+		bool found = false;
+		bool batch = false;
+		hmutex::ScopeLock lock;
+		while (thread->isRunning())
+		{
+			lock.acquire(&font->asyncMutex);
+			// batches are processed first since the main thread is waiting for them
+			batch = (font->asyncBatchQueue.size() > 0);
+			found = (batch || font->asyncQueue.size() > 0);
+			if (found)
+			{
+				charCode = (batch ? font->asyncBatchQueue.removeFirst() : font->asyncQueue.removeFirst());
+			}
+			else
+			{
+				// instead of polling, the thread stops and is started again by _startAsyncLoading() when characters are queued
+				loaderThread->idle = true;
+			}
+			lock.release();
+			if (!found)
+			{
+				break;
+			}
+			container = CharacterImageContainer(charCode);
+			if (!font->_tryLoadCharacterImageAsync(loaderThread->index, charCode, container))
+			{
+				container.image = NULL; // failed characters are still returned so their pending definitions can be removed
+			}
+			lock.acquire(&font->asyncMutex);
+			if (batch)
+			{
+				font->asyncBatchLoadedCharacters += container;
+			}
+			else
+			{
+				font->asyncLoadedCharacters += container;
+			}
+			lock.release();
+		}
+	}
+
+	void FontDynamic::_startAsyncLoading()
+	{
+		if (this->asyncThreads.size() > 0)
+		{
+			hmutex::ScopeLock lock(&this->asyncMutex);
+			for_iter (i, 0, this->asyncThreads.size())
+			{
+				if (this->asyncThreads[i]->idle)
+				{
+					// the thread has already left its loop, it doesn't take the mutex anymore
+					this->asyncThreads[i]->join();
+					delete this->asyncThreads[i];
+					this->asyncThreads[i] = new AsyncLoaderThread(this, i);
+					this->asyncThreads[i]->start();
+				}
+			}
+			return;
+		}
+		this->_prepareAsyncLoading(this->loaderThreadCount);
+		AsyncLoaderThread* thread = NULL;
+		for_iter (i, 0, this->loaderThreadCount)
+		{
+			thread = new AsyncLoaderThread(this, i);
+			this->asyncThreads += thread;
+			thread->start();
+		}
+	}
+
+	void FontDynamic::_stopAsyncLoading()
+	{
+		foreach (AsyncLoaderThread*, it, this->asyncThreads)
+		{
+			(*it)->join();
+			delete (*it);
+		}
+		this->asyncThreads.clear();
+	}
+
+	void FontDynamic::_updateAsyncLoading()
+	{
+		int frame = Font::_getCurrentFrame();
+		if (this->asyncFrame == frame) // loaded characters are added only once per frame
+		{
+			return;
+		}
+		this->asyncFrame = frame;
+		harray<CharacterImageContainer> containers;
+		hmutex::ScopeLock lock(&this->asyncMutex);
+		if (this->asyncCharactersPerFrame > 0 && this->asyncLoadedCharacters.size() > this->asyncCharactersPerFrame)
+		{
+			containers = this->asyncLoadedCharacters.removeFirst(this->asyncCharactersPerFrame);
+		}
+		else
+		{
+			containers = this->asyncLoadedCharacters;
+			this->asyncLoadedCharacters.clear();
+		}
+		lock.release();
+		this->_addAsyncLoadedCharacterImages(containers);
+	}
+
+	void FontDynamic::_addAsyncLoadedCharacterImages(harray<CharacterImageContainer>& containers)
+	{
+		if (containers.size() == 0)
+		{
+			return;
+		}
+		harray<CharacterImageContainer> loaded;
+		CharacterDefinition* character = NULL;
+		foreach (CharacterImageContainer, it, containers)
+		{
+			character = this->characters.tryGet((*it).charCode, NULL);
+			if (character == NULL || !character->pending) // character was removed in the meantime
+			{
+				if ((*it).image != NULL)
+				{
+					delete (*it).image;
+				}
+			}
+			else if ((*it).image != NULL)
+			{
+				loaded += (*it);
+			}
+			else
+			{
+				delete character;
+				this->characters.removeKey((*it).charCode);
+				this->_updateGlyph((*it).charCode);
+			}
+		}
+		this->_addCharacterImages(loaded, false);
+		if (atres::renderer != NULL)
+		{
+			atres::renderer->clearPendingCache();
+		}
+	}
+
+	bool FontDynamic::_tryAddBorderCharacterBitmap(unsigned int charCode, float borderThickness)
+	{
+		if (Font::hasBorderCharacter(charCode, borderThickness)) // cannot use current class' implementation since it would cause recursion
+		{
+			return true;
+		}
+		borderThickness = Font::quantizeBorderThickness(borderThickness); // all symbols with the same border thickness ID have to look the same
+		april::Image* image = this->_createBorderCharacterImage(charCode, borderThickness);
+		if (image == NULL)
+		{
+			return false;
+		}
+		return this->_addBorderCharacterImage(charCode, borderThickness, image);
+	}
+
+	april::Image* FontDynamic::_createBorderCharacterImage(unsigned int charCode, float borderThickness)
+	{
+		if (this->borderMode == BorderMode::FontNative)
+		{
+			return this->_loadBorderCharacterImage(charCode, borderThickness);
+		}
+		if (this->borderMode != BorderMode::Software)
+		{
+			return this->_generateBorderCharacterImage(charCode, borderThickness);
+		}
+		return NULL;
+	}
+
+	bool FontDynamic::_addBorderCharacterImage(unsigned int charCode, float borderThickness, april::Image* image)
+	{
+		// this makes sure that there is no vertical overlap between characters
+		BorderCharacterDefinition* borderCharacter = new BorderCharacterDefinition(borderThickness);
+		int charWidth = image->w + SAFE_SPACE * 2;
+		int charHeight = image->h + SAFE_SPACE * 2;
+		// add bitmap to texture
+		this->_tryCreateFirstBorderTextureContainer(borderThickness);
+		harray<TextureContainer*>& textureContainers = this->_getBorderTextureContainers(borderThickness);
+		int textureContainerCount = textureContainers.size();
+		gvec2i position;
+		TextureContainer* textureContainer = this->_addBitmap(textureContainers, false, image, charWidth, charHeight, hsprintf("border-character 0x%X", charCode), position, 0, 0, SAFE_SPACE);
+		if (textureContainers.size() > textureContainerCount)
+		{
+			this->borderTextureContainers += textureContainers(textureContainerCount, textureContainers.size() - textureContainerCount).cast<BorderTextureContainer*>();
+		}
+		if (textureContainer == NULL)
+		{
+			delete borderCharacter;
+			return false;
+		}
+		// character definition
+		borderCharacter->rect.set((float)position.x, (float)position.y, (float)charWidth, (float)charHeight);
+		borderCharacter->textureIndex = this->borderTextureContainers.indexOf((BorderTextureContainer*)textureContainer);
+		borderCharacter->channel = textureContainer->channel;
+		this->borderCharacters[Font::makeBorderThicknessId(borderThickness)][charCode] = borderCharacter;
+		textureContainer->characters += charCode;
+		return true;
+	}
+
+	bool FontDynamic::_tryAddIconBitmap(chstr iconName, bool initial)
+	{
+		if (this->icons.hasKey(iconName))
+		{
+			return true;
+		}
+		float advance = 0.0f;
+		april::Image* image = this->_loadIconImage(iconName, initial, advance);
+		if (image == NULL)
+		{
+			return false;
+		}
+		// this makes sure that there is no vertical overlap between icons
 		int iconHeight = image->h;
 		int iconWidth = image->w;
 		// add bitmap to texture
 		this->_tryCreateFirstTextureContainer();
-		TextureContainer* textureContainer = this->_addBitmap(this->textureContainers, initial, image, iconWidth, iconHeight, hsprintf("icon '%s'", iconName.cStr()));
+		gvec2i position;
+		TextureContainer* textureContainer = this->_addBitmap(this->textureContainers, initial, image, iconWidth, iconHeight, hsprintf("icon '%s'", iconName.cStr()), position);
+		if (textureContainer == NULL)
+		{
+			return false;
+		}
 		// icon definition
 		IconDefinition* icon = new IconDefinition();
-		icon->rect.set((float)textureContainer->penX, (float)textureContainer->penY, (float)iconWidth, (float)iconHeight);
+		icon->rect.set((float)position.x, (float)position.y, (float)iconWidth, (float)iconHeight);
 		icon->advance = advance;
+		icon->textureIndex = this->textureContainers.indexOf(textureContainer);
+		icon->channel = textureContainer->channel;
 		this->icons[iconName] = icon;
 		textureContainer->icons += iconName;
-		textureContainer->penX += iconWidth + CHARACTER_SPACE * 2;
 		return true;
 	}
 
@@ -308,6 +1421,7 @@ namespace atres
 		{
 			return true;
 		}
+		borderThickness = Font::quantizeBorderThickness(borderThickness); // all symbols with the same border thickness ID have to look the same
 		april::Image* image = NULL;
 		if (this->borderMode == BorderMode::FontNative)
 		{
@@ -321,63 +1435,266 @@ namespace atres
 		{
 			return false;
 		}
-		// this makes sure that there is no vertical overlap between characters
-		BorderIconDefinition* borderIcon = new BorderIconDefinition(borderThickness);
-		int iconWidth = image->w + SAFE_SPACE * 2;
-		int iconHeight = image->h + SAFE_SPACE * 2;
-		// add bitmap to texture
-		this->_tryCreateFirstBorderTextureContainer(borderThickness);
-		harray<BorderTextureContainer*> borderTextureContainers = this->_getBorderTextureContainers(borderThickness);
-		harray<TextureContainer*> textureContainers = borderTextureContainers.cast<TextureContainer*>();
-		TextureContainer* textureContainer = this->_addBitmap(textureContainers, false, image, iconWidth, iconHeight, "border-icon " + iconName, 0, 0, SAFE_SPACE);
-		if (textureContainers.size() > borderTextureContainers.size())
+		// this makes sure that there is no vertical overlap between characters
+		BorderIconDefinition* borderIcon = new BorderIconDefinition(borderThickness);
+		int iconWidth = image->w + SAFE_SPACE * 2;
+		int iconHeight = image->h + SAFE_SPACE * 2;
+		// add bitmap to texture
+		this->_tryCreateFirstBorderTextureContainer(borderThickness);
+		harray<TextureContainer*>& textureContainers = this->_getBorderTextureContainers(borderThickness);
+		int textureContainerCount = textureContainers.size();
+		gvec2i position;
+		TextureContainer* textureContainer = this->_addBitmap(textureContainers, false, image, iconWidth, iconHeight, "border-icon " + iconName, position, 0, 0, SAFE_SPACE);
+		if (textureContainers.size() > textureContainerCount)
+		{
+			this->borderTextureContainers += textureContainers(textureContainerCount, textureContainers.size() - textureContainerCount).cast<BorderTextureContainer*>();
+		}
+		if (textureContainer == NULL)
+		{
+			delete borderIcon;
+			return false;
+		}
+		// character definition
+		borderIcon->rect.set((float)position.x, (float)position.y, (float)iconWidth, (float)iconHeight);
+		borderIcon->textureIndex = this->borderTextureContainers.indexOf((BorderTextureContainer*)textureContainer);
+		borderIcon->channel = textureContainer->channel;
+		this->borderIcons[Font::makeBorderThicknessId(borderThickness)][iconName] = borderIcon;
+		textureContainer->icons += iconName;
+		return true;
+	}
+
+	TextureContainer* FontDynamic::_findRecyclableTextureContainer(harray<TextureContainer*>& textureContainers)
+	{
+		if (this->maxTextureCount <= 0 || textureContainers.size() < this->maxTextureCount)
+		{
+			return NULL;
+		}
+		int frame = Font::_getCurrentFrame();
+		TextureContainer* result = NULL;
+		foreach (TextureContainer*, it, textureContainers)
+		{
+			// textures used in the current frame could still be referenced by queued or currently created geometry
+			if ((*it)->lastUsedFrame < frame && (result == NULL || (*it)->lastUsedFrame < result->lastUsedFrame))
+			{
+				result = (*it);
+			}
+		}
+		return result;
+	}
+
+	void FontDynamic::_recycleTextureContainer(TextureContainer* textureContainer)
+	{
+		BorderTextureContainer* borderTextureContainer = dynamic_cast<BorderTextureContainer*>(textureContainer);
+		if (borderTextureContainer == NULL)
+		{
+			foreach (unsigned int, it, textureContainer->characters)
+			{
+				delete this->characters[*it];
+				this->characters.removeKey(*it);
+				this->_updateGlyph(*it);
+			}
+			foreach (hstr, it, textureContainer->icons)
+			{
+				delete this->icons[*it];
+				this->icons.removeKey(*it);
+			}
+		}
+		else
+		{
+			int borderThicknessId = Font::makeBorderThicknessId(borderTextureContainer->borderThickness);
+			hmap<unsigned int, BorderCharacterDefinition*>& borderCharacters = this->borderCharacters[borderThicknessId];
+			foreach (unsigned int, it, textureContainer->characters)
+			{
+				delete borderCharacters[*it];
+				borderCharacters.removeKey(*it);
+			}
+			hmap<hstr, BorderIconDefinition*>& borderIcons = this->borderIcons[borderThicknessId];
+			foreach (hstr, it, textureContainer->icons)
+			{
+				delete borderIcons[*it];
+				borderIcons.removeKey(*it);
+			}
+		}
+		hlog::debugf(logTag, "Font '%s': recycling texture with %d symbols.", this->name.cStr(), textureContainer->characters.size() + textureContainer->icons.size());
+		textureContainer->characters.clear();
+		textureContainer->icons.clear();
+		if (atres::renderer != NULL)
+		{
+			atres::renderer->clearCache(textureContainer->texture);
+		}
+		this->_initializeTextureContainer(textureContainer);
+		++this->recycledTextureCount;
+	}
+
+	TextureContainer* FontDynamic::_addBitmap(harray<TextureContainer*>& textureContainers, bool initial, april::Image* image, int usedWidth, int usedHeight, chstr symbol,
+		gvec2i& position, int offsetX, int offsetY, int safeSpace)
+	{
+		// the reserved area includes the spacing to the next symbol
+		grecti rect(0, 0, usedWidth + offsetX + CHARACTER_SPACE * 2, usedHeight + offsetY + CHARACTER_SPACE * 2);
+		TextureContainer* textureContainer = NULL;
+		gvec2i current;
+		if (this->atlasPool != NULL)
+		{
+			textureContainer = this->_reserveAtlasPoolArea(textureContainers, rect, symbol);
+			if (textureContainer == NULL)
+			{
+				delete image;
+				return NULL;
+			}
+		}
+		else
+		{
+			// use the lowest free position on all textures
+			foreach (TextureContainer*, it, textureContainers)
+			{
+				if ((*it)->findPosition(rect.w, rect.h, current) && (textureContainer == NULL || current.y < rect.y))
+				{
+					textureContainer = (*it);
+					rect.setPosition(current);
+				}
+			}
+			// small textures grow before textures are recycled or created
+			if (textureContainer == NULL)
+			{
+				foreach (TextureContainer*, it, textureContainers)
+				{
+					if (this->_growTextureContainer((*it), rect.w, rect.h, current))
+					{
+						textureContainer = (*it);
+						rect.setPosition(current);
+						break;
+					}
+				}
+			}
+			if (textureContainer == NULL)
+			{
+				textureContainer = this->_findRecyclableTextureContainer(textureContainers);
+				if (textureContainer != NULL)
+				{
+					this->_recycleTextureContainer(textureContainer);
+				}
+				else
+				{
+					if (textureContainers.size() > 0)
+					{
+						hlog::debugf(logTag, "Font '%s': %s does not fit, creating new texture.", this->name.cStr(), symbol.cStr());
+						textureContainer = textureContainers.last()->createNew();
+					}
+					else
+					{
+						textureContainer = new TextureContainer();
+					}
+					this->_addTextureContainer(textureContainers, textureContainer);
+				}
+				if (!textureContainer->findPosition(rect.w, rect.h, current) && !this->_growTextureContainer(textureContainer, rect.w, rect.h, current))
+				{
+					hlog::errorf(logTag, "Font '%s': %s is too big for the texture size %d!", this->name.cStr(), symbol.cStr(), this->textureSize);
+					delete image;
+					return NULL;
+				}
+				rect.setPosition(current);
+			}
+			textureContainer->reserve(rect);
+		}
+		textureContainer->lastUsedFrame = Font::_getCurrentFrame();
+		position.set(rect.x + offsetX, rect.y);
+		if (textureContainer->image != NULL)
+		{
+			// uploaded later together with other changes, see uploadTextures()
+			if (textureContainer->channel >= 0)
+			{
+				FontDynamic::_writeImageChannel(textureContainer->image, position.x + safeSpace, position.y + offsetY + safeSpace, textureContainer->channel, image);
+			}
+			else
+			{
+				textureContainer->image->write(0, 0, image->w, image->h, position.x + safeSpace, position.y + offsetY + safeSpace, image);
+			}
+			textureContainer->addDirtyRect(grecti(position.x + safeSpace, position.y + offsetY + safeSpace, image->w, image->h));
+		}
+		else
+		{
+			textureContainer->texture->write(0, 0, image->w, image->h, position.x + safeSpace, position.y + offsetY + safeSpace, image);
+		}
+		delete image;
+		return textureContainer;
+	}
+
+	int FontDynamic::uploadTextures()
+	{
+		if (this->asyncLoading)
+		{
+			this->_updateAsyncLoading();
+		}
+		if (this->retiredTextures.size() > 0)
+		{
+			this->_updateRetiredTextures();
+		}
+		int count = 0;
+		int area = 0;
+		std::chrono::steady_clock::time_point start;
+		foreach (TextureContainer*, it, this->textureContainers)
+		{
+			area = (*it)->dirtyRect.w * (*it)->dirtyRect.h;
+			start = std::chrono::steady_clock::now();
+			if ((*it)->upload())
+			{
+				this->uploadTime += (int64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+				this->uploadArea += area;
+				++count;
+			}
+		}
+		foreach (BorderTextureContainer*, it, this->borderTextureContainers)
 		{
-			this->borderTextureContainers += textureContainers(borderTextureContainers.size(), textureContainers.size() - borderTextureContainers.size()).cast<BorderTextureContainer*>();
+			area = (*it)->dirtyRect.w * (*it)->dirtyRect.h;
+			start = std::chrono::steady_clock::now();
+			if ((*it)->upload())
+			{
+				this->uploadTime += (int64_t)std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+				this->uploadArea += area;
+				++count;
+			}
 		}
-		// character definition
-		borderIcon->rect.set((float)textureContainer->penX, (float)textureContainer->penY, (float)iconWidth, (float)iconHeight);
-		this->borderIcons[iconName] += borderIcon;
-		textureContainer->icons += iconName;
-		textureContainer->penX += iconWidth + CHARACTER_SPACE * 2;
-		return true;
+		this->uploadCount += count;
+		return count;
 	}
 
-	TextureContainer* FontDynamic::_addBitmap(harray<TextureContainer*>& textureContainers, bool initial, april::Image* image, int usedWidth, int usedHeight, chstr symbol,
-		int offsetX, int offsetY, int safeSpace)
+	bool FontDynamic::isTextureUsageTracked() const
 	{
-		TextureContainer* textureContainer = NULL;
-		// create first texture
-		if (textureContainers.size() == 0)
-		{
-			textureContainer = new TextureContainer();
-			textureContainer->texture = this->_createTexture();
-			textureContainers += textureContainer;
-		}
-		// get texture
-		textureContainer = textureContainers.last();
-		textureContainer->penX += offsetX;
-		// if icon bitmap width exceeds space, go into next line
-		if (textureContainer->penX + usedWidth + CHARACTER_SPACE * 2 > textureContainer->texture->getWidth())
+		return (this->maxTextureCount > 0 || this->maxBorderThicknessCount > 0 || this->atlasPool != NULL || this->retiredTextures.size() > 0);
+	}
+
+	bool FontDynamic::markTextureUsed(april::Texture* texture)
+	{
+		if (this->retiredTextures.hasKey(texture))
 		{
-			textureContainer->penX = 0;
-			textureContainer->penY += textureContainer->rowHeight + CHARACTER_SPACE * 2;
-			textureContainer->rowHeight = usedHeight;
+			this->retiredTextures[texture] = Font::_getCurrentFrame();
+			return true;
 		}
-		else
+		return Font::markTextureUsed(texture);
+	}
+
+	void FontDynamic::resetUploadStatistics()
+	{
+		this->uploadCount = 0;
+		this->uploadTime = 0;
+		this->uploadArea = 0;
+	}
+
+	float FontDynamic::getAtlasOccupancy() const
+	{
+		int64_t usedArea = 0;
+		int64_t textureArea = 0;
+		foreachc (TextureContainer*, it, this->textureContainers)
 		{
-			textureContainer->rowHeight = hmax(textureContainer->rowHeight, usedHeight);
+			usedArea += (*it)->usedArea;
+			textureArea += (*it)->texture->getWidth() * (*it)->texture->getHeight();
 		}
-		if (textureContainer->penY + textureContainer->rowHeight + CHARACTER_SPACE * 2 > textureContainer->texture->getHeight())
+		foreachc (BorderTextureContainer*, it, this->borderTextureContainers)
 		{
-			hlog::debugf(logTag, "Font '%s': %s does not fit, creating new texture.", this->name.cStr(), symbol.cStr());
-			textureContainer = textureContainer->createNew();
-			textureContainer->texture = this->_createTexture();
-			textureContainers += textureContainer;
-			// if the icon's height is higher than the texture's height, this will obviously not work too well
+			usedArea += (*it)->usedArea;
+			textureArea += (*it)->texture->getWidth() * (*it)->texture->getHeight();
 		}
-		textureContainer->texture->write(0, 0, image->w, image->h, textureContainer->penX + safeSpace, textureContainer->penY + offsetY + safeSpace, image);
-		delete image;
-		return textureContainer;
+		return (textureArea > 0 ? (float)((double)usedArea / textureArea) : 0.0f);
 	}
 
 	april::Image* FontDynamic::_loadCharacterImage(unsigned int charCode, bool initial, float& advance, int& leftOffset, int& topOffset, float& ascender, float& descender, float& bearingX)
@@ -385,6 +1702,20 @@ namespace atres
 		return NULL;
 	}
 
+	bool FontDynamic::_loadCharacterMetrics(unsigned int charCode, CharacterImageContainer& container, int& imageWidth, int& imageHeight)
+	{
+		return false;
+	}
+
+	void FontDynamic::_prepareAsyncLoading(int threadCount)
+	{
+	}
+
+	bool FontDynamic::_tryLoadCharacterImageAsync(int threadIndex, unsigned int charCode, CharacterImageContainer& container)
+	{
+		return false;
+	}
+
 	april::Image* FontDynamic::_loadBorderCharacterImage(unsigned int charCode, float borderThickness)
 	{
 		return NULL;
@@ -392,38 +1723,45 @@ namespace atres
 
 	april::Image* FontDynamic::_generateBorderCharacterImage(unsigned int charCode, float borderThickness)
 	{
-		float advance = 0;
-		int leftOffset = 0;
-		int topOffset = 0;
-		float ascender = 0;
-		float descender = 0;
-		float bearingX = 0;
-		april::Image* characterImage = this->_loadCharacterImage(charCode, false, advance, leftOffset, topOffset, ascender, descender, bearingX);
-		if (characterImage == NULL)
-		{
-			return NULL;
-		}
-		StructuringImageContainer* structuringImageContainer = this->_findStructuringImageContainer(this->borderMode, borderThickness);
-		if (structuringImageContainer == NULL)
-		{
-			structuringImageContainer = this->_createStructuringImageContainer(this->borderMode, borderThickness);
-		}
-		if (structuringImageContainer == NULL)
+		StructuringImageContainer* structuringImageContainer = NULL;
+		if (!this->fastDilation)
 		{
-			delete characterImage;
-			return NULL;
+			structuringImageContainer = this->_findStructuringImageContainer(this->borderMode, borderThickness);
+			if (structuringImageContainer == NULL)
+			{
+				structuringImageContainer = this->_createStructuringImageContainer(this->borderMode, borderThickness);
+			}
+			if (structuringImageContainer == NULL)
+			{
+				return NULL;
+			}
 		}
-		if (characterImage->format != april::Image::Format::Alpha && characterImage->format != april::Image::Format::Greyscale)
+		int borderSize = hceil(borderThickness);
+		april::Image* image = this->_readPaddedCharacterImage(charCode, borderSize);
+		if (image == NULL)
 		{
-			april::Image* alphaImage = characterImage->extractAlpha();
+			float advance = 0;
+			int leftOffset = 0;
+			int topOffset = 0;
+			float ascender = 0;
+			float descender = 0;
+			float bearingX = 0;
+			april::Image* characterImage = this->_loadCharacterImage(charCode, false, advance, leftOffset, topOffset, ascender, descender, bearingX);
+			if (characterImage == NULL)
+			{
+				return NULL;
+			}
+			if (characterImage->format != april::Image::Format::Alpha && characterImage->format != april::Image::Format::Greyscale)
+			{
+				april::Image* alphaImage = characterImage->extractAlpha();
+				delete characterImage;
+				characterImage = alphaImage;
+			}
+			image = april::Image::create(characterImage->w + borderSize * 2, characterImage->h + borderSize * 2, april::Color::Clear, april::Image::Format::Alpha);
+			image->write(0, 0, characterImage->w, characterImage->h, borderSize, borderSize, characterImage);
 			delete characterImage;
-			characterImage = alphaImage;
 		}
-		int borderSize = hceil(borderThickness);
-		april::Image* image = april::Image::create(characterImage->w + borderSize * 2, characterImage->h + borderSize * 2, april::Color::Clear, april::Image::Format::Alpha);
-		image->write(0, 0, characterImage->w, characterImage->h, borderSize, borderSize, characterImage);
-		delete characterImage;
-		if (image != NULL && !image->dilate(structuringImageContainer->image))
+		if (image != NULL && !this->_dilateBorderImage(image, borderThickness, structuringImageContainer))
 		{
 			delete image;
 			image = NULL;
@@ -441,6 +1779,56 @@ namespace atres
 		return NULL;
 	}
 
+	april::Image* FontDynamic::_readPaddedCharacterImage(unsigned int charCode, int borderSize)
+	{
+		CharacterDefinition* character = this->characters.tryGet(charCode, NULL);
+		if (character == NULL || character->pending || character->textureIndex < 0 || character->textureIndex >= this->textureContainers.size())
+		{
+			return NULL;
+		}
+		// only the CPU-side copy can be read, other formats than alpha or a packed channel would have to be converted first
+		april::Image* textureImage = this->textureContainers[character->textureIndex]->image;
+		if (textureImage == NULL || (character->channel < 0 && textureImage->format != april::Image::Format::Alpha && textureImage->format != april::Image::Format::Greyscale))
+		{
+			return NULL;
+		}
+		// the character's rectangle includes the safe space around the glyph's bitmap
+		int x = (int)character->rect.x + SAFE_SPACE;
+		int y = (int)character->rect.y + SAFE_SPACE;
+		int w = (int)character->rect.w - SAFE_SPACE * 2;
+		int h = (int)character->rect.h - SAFE_SPACE * 2;
+		if (w <= 0 || h <= 0)
+		{
+			return NULL;
+		}
+		april::Image* image = april::Image::create(w + borderSize * 2, h + borderSize * 2, april::Color::Clear, april::Image::Format::Alpha);
+		if (image == NULL)
+		{
+			return NULL;
+		}
+		if (character->channel >= 0)
+		{
+			int bpp = textureImage->format.getBpp();
+			const unsigned char* src = NULL;
+			unsigned char* dest = NULL;
+			for_iter (j, 0, h)
+			{
+				src = textureImage->data + ((y + j) * textureImage->w + x) * bpp + character->channel;
+				dest = image->data + (borderSize + j) * image->w + borderSize;
+				for_iter (i, 0, w)
+				{
+					dest[i] = src[i * bpp];
+				}
+			}
+		}
+		else if (!image->write(x, y, w, h, borderSize, borderSize, textureImage))
+		{
+			delete image;
+			image = NULL;
+		}
+		return image;
+	}
+
 	april::Image* FontDynamic::_generateBorderIconImage(chstr iconName, float borderThickness)
 	{
 		float advance = 0.0f;
@@ -449,15 +1837,19 @@ namespace atres
 		{
 			return NULL;
 		}
-		StructuringImageContainer* structuringImageContainer = this->_findStructuringImageContainer(this->borderMode, borderThickness);
-		if (structuringImageContainer == NULL)
-		{
-			structuringImageContainer = this->_createStructuringImageContainer(this->borderMode, borderThickness);
-		}
-		if (structuringImageContainer == NULL)
+		StructuringImageContainer* structuringImageContainer = NULL;
+		if (!this->fastDilation)
 		{
-			delete iconImage;
-			return NULL;
+			structuringImageContainer = this->_findStructuringImageContainer(this->borderMode, borderThickness);
+			if (structuringImageContainer == NULL)
+			{
+				structuringImageContainer = this->_createStructuringImageContainer(this->borderMode, borderThickness);
+			}
+			if (structuringImageContainer == NULL)
+			{
+				delete iconImage;
+				return NULL;
+			}
 		}
 		if (iconImage->format != april::Image::Format::Alpha && iconImage->format != april::Image::Format::Greyscale)
 		{
@@ -469,7 +1861,7 @@ namespace atres
 		april::Image* image = april::Image::create(iconImage->w + borderSize * 2, iconImage->h + borderSize * 2, april::Color::Clear, april::Image::Format::Alpha);
 		image->write(0, 0, iconImage->w, iconImage->h, borderSize, borderSize, iconImage);
 		delete iconImage;
-		if (image != NULL && !image->dilate(structuringImageContainer->image))
+		if (image != NULL && !this->_dilateBorderImage(image, borderThickness, structuringImageContainer))
 		{
 			delete image;
 			image = NULL;
@@ -477,60 +1869,447 @@ namespace atres
 		return image;
 	}
 
-	FontDynamic::StructuringImageContainer* FontDynamic::_createStructuringImageContainer(const BorderMode& borderMode, float borderThickness)
+	april::Image* FontDynamic::createStructuringImage(const BorderMode& borderMode, float borderThickness)
 	{
-		StructuringImageContainer* structuringImageContainer = NULL;
 		int borderSize = hceil(borderThickness);
 		int size = 1 + borderSize * 2;
-		if (this->borderMode == BorderMode::PrerenderSquare)
+		april::Image* image = NULL;
+		if (borderMode == BorderMode::PrerenderSquare)
 		{
-			structuringImageContainer = new StructuringImageContainer(april::Image::create(size, size, april::Color::White, april::Image::Format::Alpha), this->borderMode, borderThickness);
+			image = april::Image::create(size, size, april::Color::White, april::Image::Format::Alpha);
 		}
-		else if (this->borderMode == BorderMode::PrerenderCircle)
+		else if (borderMode == BorderMode::PrerenderCircle)
 		{
-			structuringImageContainer = new StructuringImageContainer(april::Image::create(size, size, april::Color::Clear, april::Image::Format::Alpha), this->borderMode, borderThickness);
+			image = april::Image::create(size, size, april::Color::Clear, april::Image::Format::Alpha);
 			int index = borderSize + borderSize * size;
-			structuringImageContainer->image->data[index] = 255;
+			image->data[index] = 255;
 			unsigned char value = 0;
 			gvec2f vector;
-			gvec2f range(borderThickness, 0.0f);
 			for_iter (j, 0, borderSize + 1)
 			{
 				for_iter (i, j, borderSize + 1)
 				{
 					vector.set((float)i, (float)j);
 					value = (unsigned char)(hclamp(borderThickness + 1.0f - vector.length(), 0.0f, 1.0f) * 255);
-					structuringImageContainer->image->data[index + i + j * size] = value;
-					structuringImageContainer->image->data[index - i + j * size] = value;
-					structuringImageContainer->image->data[index + i - j * size] = value;
-					structuringImageContainer->image->data[index - i - j * size] = value;
-					structuringImageContainer->image->data[index + j + i * size] = value;
-					structuringImageContainer->image->data[index - j + i * size] = value;
-					structuringImageContainer->image->data[index + j - i * size] = value;
-					structuringImageContainer->image->data[index - j - i * size] = value;
+					image->data[index + i + j * size] = value;
+					image->data[index - i + j * size] = value;
+					image->data[index + i - j * size] = value;
+					image->data[index - i - j * size] = value;
+					image->data[index + j + i * size] = value;
+					image->data[index - j + i * size] = value;
+					image->data[index + j - i * size] = value;
+					image->data[index - j - i * size] = value;
 				}
 			}
 		}
-		else if (this->borderMode == BorderMode::PrerenderDiamond)
+		else if (borderMode == BorderMode::PrerenderDiamond)
 		{
-			structuringImageContainer = new StructuringImageContainer(april::Image::create(size, size, april::Color::Clear, april::Image::Format::Alpha), this->borderMode, borderThickness);
+			image = april::Image::create(size, size, april::Color::Clear, april::Image::Format::Alpha);
 			int index = borderSize + borderSize * size;
-			structuringImageContainer->image->data[index] = 255;
+			image->data[index] = 255;
 			for_iter (j, 0, borderSize + 1)
 			{
 				for_iter (i, 0, borderSize + 1 - j)
 				{
-					structuringImageContainer->image->data[index + i + j * size] = 255;
-					structuringImageContainer->image->data[index - i + j * size] = 255;
-					structuringImageContainer->image->data[index + i - j * size] = 255;
-					structuringImageContainer->image->data[index - i - j * size] = 255;
+					image->data[index + i + j * size] = 255;
+					image->data[index - i + j * size] = 255;
+					image->data[index + i - j * size] = 255;
+					image->data[index - i - j * size] = 255;
 				}
 			}
 		}
+		return image;
+	}
+
+	bool FontDynamic::dilateBorderImage(april::Image* image, const BorderMode& borderMode, float borderThickness)
+	{
+		if (image == NULL || (image->format != april::Image::Format::Alpha && image->format != april::Image::Format::Greyscale))
+		{
+			return false;
+		}
+		if (borderMode == BorderMode::PrerenderSquare)
+		{
+			FontDynamic::_dilateSquare(image->data, image->w, image->h, hceil(borderThickness));
+			return true;
+		}
+		if (borderMode == BorderMode::PrerenderCircle)
+		{
+			FontDynamic::_dilateDistance(image->data, image->w, image->h, borderThickness, true);
+			return true;
+		}
+		if (borderMode == BorderMode::PrerenderDiamond)
+		{
+			FontDynamic::_dilateDistance(image->data, image->w, image->h, (float)hceil(borderThickness), false); // the diamond has no antialiased edge
+			return true;
+		}
+		return false;
+	}
+
+	bool FontDynamic::_dilateBorderImage(april::Image* image, float borderThickness, StructuringImageContainer* structuringImageContainer)
+	{
 		if (structuringImageContainer != NULL)
 		{
-			this->structuringImageContainers += structuringImageContainer;
+			return image->dilate(structuringImageContainer->image);
+		}
+		return FontDynamic::dilateBorderImage(image, this->borderMode, borderThickness);
+	}
+
+	void FontDynamic::_maxBytes(unsigned char* dest, const unsigned char* a, const unsigned char* b, int count)
+	{
+		int i = 0;
+#if defined(ATRES_SIMD_SSE2)
+		for (; i + 16 <= count; i += 16)
+		{
+			_mm_storeu_si128((__m128i*)(dest + i), _mm_max_epu8(_mm_loadu_si128((const __m128i*)(a + i)), _mm_loadu_si128((const __m128i*)(b + i))));
+		}
+#elif defined(ATRES_SIMD_NEON)
+		for (; i + 16 <= count; i += 16)
+		{
+			vst1q_u8(dest + i, vmaxq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			dest[i] = hmax(a[i], b[i]);
+		}
+	}
+
+	void FontDynamic::_dilateColumns(unsigned char* data, int width, int height, int radius)
+	{
+		// van Herk/Gil-Werman: the maximum of any window of "size" rows is the maximum of a suffix and a prefix of two
+		// neighboring blocks of "size" rows which makes the cost independent of the radius, rows outside count as empty
+		int size = radius * 2 + 1;
+		int count = (height + radius * 2 + size - 1) / size * size;
+		unsigned char* empty = new unsigned char[width];
+		memset(empty, 0, width);
+		unsigned char* prefixes = new unsigned char[count * width];
+		unsigned char* suffixes = new unsigned char[count * width];
+		const unsigned char* row = NULL;
+		for_iter (i, 0, count)
+		{
+			row = (i >= radius && i < height + radius ? &data[(i - radius) * width] : empty);
+			if (i % size == 0)
+			{
+				memcpy(&prefixes[i * width], row, width);
+			}
+			else
+			{
+				FontDynamic::_maxBytes(&prefixes[i * width], &prefixes[(i - 1) * width], row, width);
+			}
+		}
+		for (int i = count - 1; i >= 0; --i)
+		{
+			row = (i >= radius && i < height + radius ? &data[(i - radius) * width] : empty);
+			if (i % size == size - 1)
+			{
+				memcpy(&suffixes[i * width], row, width);
+			}
+			else
+			{
+				FontDynamic::_maxBytes(&suffixes[i * width], &suffixes[(i + 1) * width], row, width);
+			}
+		}
+		// the window of output row y covers the padded rows y to y + size - 1
+		for_iter (y, 0, height)
+		{
+			FontDynamic::_maxBytes(&data[y * width], &suffixes[y * width], &prefixes[(y + size - 1) * width], width);
+		}
+		delete[] suffixes;
+		delete[] prefixes;
+		delete[] empty;
+	}
+
+	void FontDynamic::_transposeBytes(const unsigned char* src, unsigned char* dest, int width, int height)
+	{
+		for_iter (y, 0, height)
+		{
+			for_iter (x, 0, width)
+			{
+				dest[x * height + y] = src[y * width + x];
+			}
+		}
+	}
+
+	void FontDynamic::_dilateSquare(unsigned char* data, int width, int height, int radius)
+	{
+		if (radius <= 0 || width <= 0 || height <= 0)
+		{
+			return;
+		}
+		// both passes work on whole rows so the byte maximum can be vectorized, the horizontal pass uses the transposed image
+		FontDynamic::_dilateColumns(data, width, height, radius);
+		unsigned char* transposed = new unsigned char[width * height];
+		FontDynamic::_transposeBytes(data, transposed, width, height);
+		FontDynamic::_dilateColumns(transposed, height, width, radius);
+		FontDynamic::_transposeBytes(transposed, data, height, width);
+		delete[] transposed;
+	}
+
+	void FontDynamic::_transformDistanceLine(const float* f, float* d, int count, int* v, float* z)
+	{
+		// lower envelope of parabolas (Felzenszwalb/Huttenlocher), results are squared euclidean distances
+		int first = 0;
+		while (first < count && f[first] >= DISTANCE_INFINITY)
+		{
+			++first;
+		}
+		if (first >= count)
+		{
+			for_iter (q, 0, count)
+			{
+				d[q] = DISTANCE_INFINITY;
+			}
+			return;
+		}
+		int k = 0;
+		float s = 0.0f;
+		v[0] = first;
+		z[0] = -DISTANCE_INFINITY;
+		z[1] = DISTANCE_INFINITY;
+		for_iter (q, first + 1, count)
+		{
+			if (f[q] >= DISTANCE_INFINITY) // pixels outside of the symbol don't add a parabola
+			{
+				continue;
+			}
+			s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+			while (s <= z[k])
+			{
+				--k;
+				s = ((f[q] + q * q) - (f[v[k]] + v[k] * v[k])) / (2 * q - 2 * v[k]);
+			}
+			++k;
+			v[k] = q;
+			z[k] = s;
+			z[k + 1] = DISTANCE_INFINITY;
+		}
+		k = 0;
+		for_iter (q, 0, count)
+		{
+			while (z[k + 1] < q)
+			{
+				++k;
+			}
+			d[q] = (float)((q - v[k]) * (q - v[k])) + f[v[k]];
+		}
+	}
+
+	void FontDynamic::_transformDistances(float* distances, int width, int height)
+	{
+		// separable, first along columns and then along rows
+		int maxSize = hmax(width, height);
+		float* f = new float[maxSize];
+		float* d = new float[maxSize];
+		int* v = new int[maxSize];
+		float* z = new float[maxSize + 1];
+		for_iter (x, 0, width)
+		{
+			for_iter (y, 0, height)
+			{
+				f[y] = distances[x + y * width];
+			}
+			FontDynamic::_transformDistanceLine(f, d, height, v, z);
+			for_iter (y, 0, height)
+			{
+				distances[x + y * width] = d[y];
+			}
+		}
+		for_iter (y, 0, height)
+		{
+			FontDynamic::_transformDistanceLine(&distances[y * width], d, width, v, z);
+			memcpy(&distances[y * width], d, width * sizeof(float));
+		}
+		delete[] z;
+		delete[] v;
+		delete[] d;
+		delete[] f;
+		int pixelCount = width * height;
+		for_iter (i, 0, pixelCount)
+		{
+			distances[i] = (distances[i] < DISTANCE_INFINITY ? sqrtf(distances[i]) : DISTANCE_INFINITY);
+		}
+	}
+
+	void FontDynamic::_dilateDistance(unsigned char* data, int width, int height, float borderThickness, bool euclidean)
+	{
+		if (borderThickness <= 0.0f || width <= 0 || height <= 0)
+		{
+			return;
+		}
+		// the distance to the closest pixel of the symbol is calculated for every pixel in linear time, this is the same as
+		// dilating with the circle or diamond structuring image for fully covered pixels; partially covered pixels start
+		// with an edge offset of 1 - coverage so thin strokes that never reach full coverage still get a border
+		int pixelCount = width * height;
+		float* distances = new float[pixelCount];
+		float offset = 0.0f;
+		for_iter (i, 0, pixelCount)
+		{
+			if (data[i] == 0)
+			{
+				distances[i] = DISTANCE_INFINITY;
+			}
+			else
+			{
+				offset = 1.0f - data[i] / 255.0f;
+				// the euclidean transform works with squared distances
+				distances[i] = (euclidean ? offset * offset : offset);
+			}
+		}
+		if (euclidean)
+		{
+			FontDynamic::_transformDistances(distances, width, height);
+		}
+		else // city block distances are exact with a forward and a backward pass
+		{
+			int index = 0;
+			for_iter (y, 0, height)
+			{
+				for_iter (x, 0, width)
+				{
+					index = x + y * width;
+					if (x > 0)
+					{
+						distances[index] = hmin(distances[index], distances[index - 1] + 1.0f);
+					}
+					if (y > 0)
+					{
+						distances[index] = hmin(distances[index], distances[index - width] + 1.0f);
+					}
+				}
+			}
+			for (int y = height - 1; y >= 0; --y)
+			{
+				for (int x = width - 1; x >= 0; --x)
+				{
+					index = x + y * width;
+					if (x < width - 1)
+					{
+						distances[index] = hmin(distances[index], distances[index + 1] + 1.0f);
+					}
+					if (y < height - 1)
+					{
+						distances[index] = hmin(distances[index], distances[index + width] + 1.0f);
+					}
+				}
+			}
+		}
+		// same falloff as the structuring images, partially covered pixels of the symbol itself are kept
+		unsigned char* border = new unsigned char[width];
+		for_iter (y, 0, height)
+		{
+			for_iter (x, 0, width)
+			{
+				border[x] = (unsigned char)(hclamp(borderThickness + 1.0f - distances[x + y * width], 0.0f, 1.0f) * 255);
+			}
+			FontDynamic::_maxBytes(&data[y * width], &data[y * width], border, width);
+		}
+		delete[] border;
+		delete[] distances;
+	}
+
+	april::Image* FontDynamic::createDistanceField(april::Image* image, int spread)
+	{
+		if (image == NULL || spread <= 0)
+		{
+			return NULL;
+		}
+		april::Image* alphaImage = image;
+		if (image->format != april::Image::Format::Alpha && image->format != april::Image::Format::Greyscale)
+		{
+			alphaImage = image->extractAlpha();
+		}
+		int width = image->w + spread * 2;
+		int height = image->h + spread * 2;
+		int pixelCount = width * height;
+		april::Image* field = april::Image::create(width, height, april::Color::Clear, april::Image::Format::Alpha);
+		field->write(0, 0, alphaImage->w, alphaImage->h, spread, spread, alphaImage);
+		if (alphaImage != image)
+		{
+			delete alphaImage;
+		}
+		// distances to the closest pixel inside and to the closest pixel outside of the symbol
+		float* insideDistances = new float[pixelCount];
+		float* outsideDistances = new float[pixelCount];
+		for_iter (i, 0, pixelCount)
+		{
+			if (field->data[i] >= DISTANCE_INSIDE_THRESHOLD)
+			{
+				insideDistances[i] = 0.0f;
+				outsideDistances[i] = DISTANCE_INFINITY;
+			}
+			else
+			{
+				insideDistances[i] = DISTANCE_INFINITY;
+				outsideDistances[i] = 0.0f;
+			}
+		}
+		FontDynamic::_transformDistances(insideDistances, width, height);
+		FontDynamic::_transformDistances(outsideDistances, width, height);
+		// the edge lies half a pixel between the centers of an inside and an outside pixel, partially covered pixels are on the edge itself
+		float distance = 0.0f;
+		for_iter (i, 0, pixelCount)
+		{
+			distance = (insideDistances[i] == 0.0f ? outsideDistances[i] - 0.5f : 0.5f - insideDistances[i]);
+			if (field->data[i] > 0 && field->data[i] < 255)
+			{
+				distance = field->data[i] / 255.0f - 0.5f;
+			}
+			field->data[i] = (unsigned char)hround(hclamp(0.5f + distance / (spread * 2), 0.0f, 1.0f) * 255);
+		}
+		delete[] outsideDistances;
+		delete[] insideDistances;
+		return field;
+	}
+
+	april::Image* FontDynamic::decodeDistanceField(april::Image* field, int spread, float scale, float borderThickness)
+	{
+		if (field == NULL || spread <= 0 || scale <= 0.0f || (field->format != april::Image::Format::Alpha && field->format != april::Image::Format::Greyscale))
+		{
+			return NULL;
+		}
+		int width = hmax(hround(field->w * scale), 1);
+		int height = hmax(hround(field->h * scale), 1);
+		april::Image* image = april::Image::create(width, height, april::Color::Clear, april::Image::Format::Alpha);
+		float fx = 0.0f;
+		float fy = 0.0f;
+		int x0 = 0;
+		int y0 = 0;
+		int x1 = 0;
+		int y1 = 0;
+		float value = 0.0f;
+		float distance = 0.0f;
+		for_iter (y, 0, height)
+		{
+			// bilinear filtering like on the GPU, sampled at the pixel centers
+			fy = hclamp((y + 0.5f) / scale - 0.5f, 0.0f, (float)(field->h - 1));
+			y0 = (int)fy;
+			y1 = hmin(y0 + 1, field->h - 1);
+			fy -= y0;
+			for_iter (x, 0, width)
+			{
+				fx = hclamp((x + 0.5f) / scale - 0.5f, 0.0f, (float)(field->w - 1));
+				x0 = (int)fx;
+				x1 = hmin(x0 + 1, field->w - 1);
+				fx -= x0;
+				value = ((field->data[x0 + y0 * field->w] * (1.0f - fx) + field->data[x1 + y0 * field->w] * fx) * (1.0f - fy) +
+					(field->data[x0 + y1 * field->w] * (1.0f - fx) + field->data[x1 + y1 * field->w] * fx) * fy) / 255.0f;
+				// signed distance in pixels of the reference size, antialiased over one destination pixel
+				distance = (value - 0.5f) * spread * 2 + borderThickness;
+				image->data[x + y * width] = (unsigned char)hround(hclamp(distance * scale + 0.5f, 0.0f, 1.0f) * 255);
+			}
+		}
+		return image;
+	}
+
+	FontDynamic::StructuringImageContainer* FontDynamic::_createStructuringImageContainer(const BorderMode& borderMode, float borderThickness)
+	{
+		april::Image* image = FontDynamic::createStructuringImage(borderMode, borderThickness);
+		if (image == NULL)
+		{
+			return NULL;
 		}
+		StructuringImageContainer* structuringImageContainer = new StructuringImageContainer(image, borderMode, borderThickness);
+		this->structuringImageContainers += structuringImageContainer;
 		return structuringImageContainer;
 	}
 
@@ -11,6 +11,7 @@
 
 #include <april/april.h>
 #include <april/RenderSystem.h>
+#include <gtypes/Matrix4.h>
 #include <gtypes/Rectangle.h>
 #include <gtypes/Vector2.h>
 #include <hltypes/harray.h>
@@ -100,12 +101,102 @@ namespace atres
 {
 	static hstr _iconPlaceholder = hstr::fromUnicode((unsigned int)0xA0);
 	static float sqrt05 = hsqrt(0.5f);
+	static harray<april::ColoredTexturedVertex> _coloredVertices;
+	static harray<april::ColoredVertex> _coloredLiningVertices;
+	static gvec2f _effectOffsets[8];
+	static RenderSequence _effectSequence;
+
+	template <typename V>
+	static grectf _makeBounds(const harray<V>& vertices)
+	{
+		float left = vertices.first().x;
+		float top = vertices.first().y;
+		float right = left;
+		float bottom = top;
+		for_iter (i, 1, vertices.size())
+		{
+			left = hmin(left, vertices[i].x);
+			top = hmin(top, vertices[i].y);
+			right = hmax(right, vertices[i].x);
+			bottom = hmax(bottom, vertices[i].y);
+		}
+		return grectf(left, top, right - left, bottom - top);
+	}
+
+	template <typename V>
+	static void _applyAlpha(const harray<V>& vertices, const harray<april::Color>& colors, const harray<unsigned char>& alphaPowers, float alpha, harray<V>& result)
+	{
+		float factors[3] = {1.0f, alpha, alpha * alpha};
+		april::Color color;
+		result = vertices;
+		for_iter (i, 0, result.size())
+		{
+			color = colors[i];
+			color.a = (unsigned char)(color.a * factors[alphaPowers[i]]);
+			result[i].color = april::rendersys->getNativeColorUInt(color);
+		}
+	}
+
+	static int _makeEffectOffsets(const RenderSequence& sequence, gvec2f* offsets)
+	{
+		if (sequence.effect == TextEffect::Shadow)
+		{
+			offsets[0] = sequence.effectOffset;
+			return 1;
+		}
+		if (sequence.effect == TextEffect::Border)
+		{
+			// same offsets as used for software borders stored as vertices
+			float thickness = sequence.effectThickness;
+			offsets[0].set(-thickness * sqrt05, -thickness * sqrt05);
+			offsets[1].set(thickness * sqrt05, -thickness * sqrt05);
+			offsets[2].set(-thickness * sqrt05, thickness * sqrt05);
+			offsets[3].set(thickness * sqrt05, thickness * sqrt05);
+			offsets[4].set(0.0f, -thickness);
+			offsets[5].set(-thickness, 0.0f);
+			offsets[6].set(thickness, 0.0f);
+			offsets[7].set(0.0f, thickness);
+			return 8;
+		}
+		return 0;
+	}
+
+	static void _translateVertices(const harray<april::TexturedVertex>& vertices, cgvec2f offset, harray<april::TexturedVertex>& result)
+	{
+		result = vertices;
+		foreach (april::TexturedVertex, it, result)
+		{
+			(*it).x += offset.x;
+			(*it).y += offset.y;
+		}
+	}
+
+	static RenderColoredSequence* _findColoredSequence(harray<RenderColoredSequence>& sequences, april::Texture* texture, int channel, int pass, cgrectf bounds)
+	{
+		// symbols within the same pass never depended on their order (see optimizeSequences()), but passes have to be rendered in order
+		for (int i = sequences.size() - 1; i >= 0; --i)
+		{
+			if (sequences[i].texture == texture && sequences[i].channel == channel)
+			{
+				return &sequences[i];
+			}
+			if (sequences[i].pass != pass && sequences[i].bounds.intersects(bounds))
+			{
+				break;
+			}
+		}
+		sequences += RenderColoredSequence();
+		RenderColoredSequence* sequence = &sequences.last();
+		sequence->texture = texture;
+		sequence->channel = channel;
+		sequence->pass = pass;
+		return sequence;
+	}
 
 	Renderer* renderer = NULL;
 
 	Renderer::Renderer() :
-		_characters(_dummyCharacters),
-		_dummyCharacters(hmap<unsigned int, CharacterDefinition*>()),
+		_glyphs(&_dummyGlyphs),
 		_icons(_dummyIcons),
 		_dummyIcons(hmap<hstr, IconDefinition*>())
 	{
@@ -120,7 +211,15 @@ namespace atres
 		this->useLegacyLineBreakParsing = false;
 		this->useIdeographWords = false;
 		this->justifiedDefault = Horizontal::Justified;
+		this->useVertexColors = false;
+		this->useEffectPasses = false;
+		this->batching = false;
+		this->drawCallCount = 0;
+		this->flushedBatchCount = 0;
+		this->frame = 0;
 		this->defaultFont = NULL;
+		this->_lastUsedTexture = NULL;
+		this->_textureUsageFontsValid = false;
 		// misc init
 		this->_font = NULL;
 		this->_iconFont = NULL;
@@ -154,6 +253,7 @@ namespace atres
 		this->_italicActive = false;
 		this->_hideActive = false;
 		this->_alpha = -1;
+		this->_batchCount = 0;
 		// cache
 		this->cacheText = new Cache<CacheEntryText>();
 		this->cacheTextUnformatted = new Cache<CacheEntryText>();
@@ -251,6 +351,24 @@ namespace atres
 		}
 	}
 
+	void Renderer::setUseVertexColors(bool value)
+	{
+		if (this->useVertexColors != value)
+		{
+			this->useVertexColors = value;
+			this->clearCache();
+		}
+	}
+
+	void Renderer::setUseEffectPasses(bool value)
+	{
+		if (this->useEffectPasses != value)
+		{
+			this->useEffectPasses = value;
+			this->clearCache();
+		}
+	}
+
 	hstr Renderer::getDefaultFontName() const
 	{
 		return (this->defaultFont != NULL ? this->defaultFont->getName() : "");
@@ -284,6 +402,20 @@ namespace atres
 		this->cacheLinesUnformatted->setMaxSize(value);
 	}
 
+	void Renderer::setBatching(bool value)
+	{
+		if (this->batching != value)
+		{
+			this->flush();
+			this->batching = value;
+		}
+	}
+
+	void Renderer::resetDrawCallCount()
+	{
+		this->drawCallCount = 0;
+	}
+
 	bool Renderer::hasFont(chstr name) const
 	{
 		return (name == "" && this->defaultFont != NULL || this->fonts.hasKey(name));
@@ -303,6 +435,7 @@ namespace atres
 		}
 		this->clearCache(); // there may be old cached definitions, they must be removed
 		this->fonts[name] = font;
+		this->_textureUsageFontsValid = false;
 		if (this->defaultFont == NULL && allowDefault)
 		{
 			this->defaultFont = font;
@@ -325,6 +458,7 @@ namespace atres
 				this->fonts.removeKey(*it);
 			}
 		}
+		this->_textureUsageFontsValid = false;
 		if (this->defaultFont == font)
 		{
 			this->defaultFont = (this->fonts.size() > 0 ? this->fonts.values().first() : NULL);
@@ -351,6 +485,7 @@ namespace atres
 	
 	void Renderer::destroyAllFonts()
 	{
+		this->_flushBatches(); // queued batches use textures of the fonts
 		this->defaultFont = NULL;
 		this->clearCache();
 		harray<Font*> fonts = this->fonts.values().removedDuplicates();
@@ -359,6 +494,7 @@ namespace atres
 			delete (*it);
 		}
 		this->fonts.clear();
+		this->_textureUsageFontsValid = false;
 	}
 	
 	void Renderer::destroyFont(Font* font)
@@ -367,6 +503,7 @@ namespace atres
 		{
 			throw Exception("Unable to destroy font, NULL argument passed to atres::Renderer::destroyFont()");
 		}
+		this->_flushBatches(); // queued batches could use textures of this font, text of other fonts has to stay as well
 		this->unregisterFont(font);
 		delete font;
 	}
@@ -392,7 +529,7 @@ namespace atres
 			if (font != NULL)
 			{
 				++position;
-				font->setScale((float)(name(position, name.size() - position)));
+				font = font->getScaledFont((float)(name(position, name.size() - position)));
 			}
 		}
 		return font;
@@ -430,6 +567,26 @@ namespace atres
 		}
 	}
 	
+	void Renderer::clearCache(april::Texture* texture)
+	{
+		int count = this->cacheText->removeEntries(texture) + this->cacheTextUnformatted->removeEntries(texture);
+		if (count > 0)
+		{
+			hlog::debugf(logTag, "Removed %d text cache entries using a changed texture.", count);
+		}
+	}
+
+	void Renderer::clearPendingCache()
+	{
+		this->cacheText->removePendingEntries();
+		this->cacheTextUnformatted->removePendingEntries();
+	}
+
+	void Renderer::updateTextureUsageTracking()
+	{
+		this->_textureUsageFontsValid = false;
+	}
+
 	void Renderer::analyzeText(chstr fontName, chstr text)
 	{
 		// makes sure dynamically allocated characters are loaded
@@ -437,6 +594,30 @@ namespace atres
 		Font* font = this->getFont(fontName);
 		if (font != NULL)
 		{
+			// all missing characters are loaded together so they can be arranged on the textures more efficiently
+			const GlyphTable& glyphs = font->getGlyphs();
+			harray<unsigned int> codes;
+			for_itert (unsigned int, i, 0, chars.size())
+			{
+				if (glyphs.get(chars[i]) == NULL)
+				{
+					codes += chars[i];
+				}
+			}
+			if (codes.size() > 0)
+			{
+				// sorted duplicates are neighbors so they are removed in a single pass
+				codes.sort();
+				harray<unsigned int> missingCodes;
+				foreach (unsigned int, it, codes)
+				{
+					if (missingCodes.size() == 0 || missingCodes.last() != (*it))
+					{
+						missingCodes += (*it);
+					}
+				}
+				font->loadCharacters(missingCodes);
+			}
 			for_itert (unsigned int, i, 0, chars.size())
 			{
 				font->hasCharacter(chars[i]);
@@ -770,7 +951,7 @@ namespace atres
 		this->_font = NULL;
 		this->_iconFont = NULL;
 		this->_texture = NULL;
-		this->_characters = this->_dummyCharacters;
+		this->_glyphs = &this->_dummyGlyphs;
 		this->_icons = this->_dummyIcons;
 		this->_height = 0.0f;
 		this->_lineHeight = 0.0f;
@@ -861,7 +1042,7 @@ namespace atres
 				{
 					this->_fontName = this->_currentTag.data;
 					this->_font = this->getFont(this->_fontName);
-					this->_characters = this->_font->getCharacters();
+					this->_glyphs = &this->_font->getGlyphs();
 					this->_icons = this->_font->getIcons();
 					this->_fontScale = this->_font->getScale();
 					this->_fontBaseScale = this->_font->getBaseScale();
@@ -870,7 +1051,7 @@ namespace atres
 				{
 					this->_fontName = this->_currentTag.data;
 					this->_font = this->getFont(this->_fontName);
-					this->_characters = this->_font->getCharacters();
+					this->_glyphs = &this->_font->getGlyphs();
 					this->_icons = this->_font->getIcons();
 					this->_fontScale = this->_font->getScale();
 					this->_fontBaseScale = this->_font->getBaseScale();
@@ -914,7 +1095,7 @@ namespace atres
 				if (this->_font != NULL)
 				{
 					this->_fontName = this->_nextTag.data;
-					this->_characters = this->_font->getCharacters();
+					this->_glyphs = &this->_font->getGlyphs();
 					this->_fontScale = this->_font->getScale();
 					this->_fontBaseScale = this->_font->getBaseScale();
 				}
@@ -1008,7 +1189,7 @@ namespace atres
 				{
 					this->_fontName = this->_currentTag.data;
 					this->_font = this->getFont(this->_fontName);
-					this->_characters = this->_font->getCharacters();
+					this->_glyphs = &this->_font->getGlyphs();
 					this->_icons = this->_font->getIcons();
 					this->_fontScale = this->_font->getScale();
 					this->_fontBaseScale = this->_font->getBaseScale();
@@ -1018,7 +1199,7 @@ namespace atres
 					this->_fontName = this->_currentTag.data;
 					this->_fontIconName = this->_currentTag.consumedData;
 					this->_font = this->getFont(this->_fontName);
-					this->_characters = this->_font->getCharacters();
+					this->_glyphs = &this->_font->getGlyphs();
 					this->_icons = this->_font->getIcons();
 					this->_fontScale = this->_font->getScale();
 					this->_fontBaseScale = this->_font->getBaseScale();
@@ -1173,7 +1354,7 @@ namespace atres
 					if (this->_font != NULL)
 					{
 						this->_fontName = this->_nextTag.data;
-						this->_characters = this->_font->getCharacters();
+						this->_glyphs = &this->_font->getGlyphs();
 						this->_fontScale = this->_font->getScale();
 						this->_fontBaseScale = this->_font->getBaseScale();
 					}
@@ -1451,6 +1632,62 @@ namespace atres
 		}
 	}
 
+	void Renderer::_loadBorderCharacters(const harray<RenderLine>& lines, const harray<FormatTag>& tags)
+	{
+		bool border = false;
+		foreachc (FormatTag, it, tags)
+		{
+			if ((*it).type == FormatTag::Type::Border)
+			{
+				border = true;
+				break;
+			}
+		}
+		if (!border)
+		{
+			return;
+		}
+		// the formatting is processed once without creating geometry so all border characters of a font and border thickness can be created together
+		this->_initializeFormatTags(tags);
+		this->_initializeRenderSequences();
+		this->_initializeLineProcessing(lines);
+		hmap<Font*, hmap<float, harray<unsigned int> > > charCodes;
+		int byteSize = 0;
+		for_iter (j, 0, this->_lines.size())
+		{
+			this->_line = this->_lines[j];
+			foreach (RenderWord, it, this->_line.words)
+			{
+				this->_word = (*it);
+				if (this->_word.icon)
+				{
+					this->_processFormatTags(this->_word.text, 0);
+					continue;
+				}
+				for_iter_step (i, 0, this->_word.text.size(), byteSize)
+				{
+					this->_code = this->_word.text.firstUnicodeChar(i, &byteSize);
+					this->_processFormatTags(this->_word.text, i);
+					if (this->_effectMode == EFFECT_MODE_BORDER && this->_font != NULL && !this->_hideActive && this->_code != UNICODE_CHAR_SPACE &&
+						this->_code != UNICODE_CHAR_ZERO_WIDTH_SPACE && this->_font->getBorderMode() != Font::BorderMode::Software && this->_glyphs->get(this->_code) != NULL)
+					{
+						charCodes[this->_font][this->borderThickness * this->_textBorderThickness / this->_fontBaseScale] += this->_code;
+					}
+				}
+			}
+		}
+		harray<Font*> fonts = charCodes.keys();
+		harray<float> borderThicknesses;
+		foreach (Font*, it, fonts)
+		{
+			borderThicknesses = charCodes[*it].keys();
+			foreach (float, it2, borderThicknesses)
+			{
+				(*it)->loadBorderCharacters(charCodes[*it][*it2], (*it2));
+			}
+		}
+	}
+
 	void Renderer::_checkSequenceSwitch()
 	{
 		if (this->_textSequence.texture != this->_texture || this->_textSequence.color != this->_textColor)
@@ -1533,6 +1770,51 @@ namespace atres
 		}
 	}
 
+	void Renderer::_checkEffectSequenceSwitch(TextEffect effect)
+	{
+		april::Color effectColor = april::Color::Clear;
+		gvec2f effectOffset;
+		float effectThickness = 0.0f;
+		if (effect == TextEffect::Shadow)
+		{
+			effectColor = this->_shadowColor;
+			effectOffset = this->_shadowOffset * (this->globalOffsets ? 1.0f : this->_scale);
+		}
+		else if (effect == TextEffect::Border)
+		{
+			effectColor = this->_borderColor;
+			effectThickness = this->_borderThickness;
+		}
+		if (this->_textSequence.effect != effect || this->_textSequence.effectColor != effectColor || this->_textSequence.effectOffset != effectOffset ||
+			this->_textSequence.effectThickness != effectThickness)
+		{
+			if (this->_textSequence.vertices.size() > 0)
+			{
+				this->_textSequences += this->_textSequence;
+				this->_textSequence.vertices.clear();
+			}
+			this->_textSequence.effect = effect;
+			this->_textSequence.effectColor = effectColor;
+			this->_textSequence.effectOffset = effectOffset;
+			this->_textSequence.effectThickness = effectThickness;
+		}
+	}
+
+	void Renderer::_checkRenderSequenceSwitch(RenderSequence& sequence, harray<RenderSequence>& sequences, april::Texture* texture, int channel)
+	{
+		// symbols from different channels of a channel-packed texture can't be sampled in the same draw call
+		if (sequence.texture != texture || sequence.channel != channel)
+		{
+			if (sequence.vertices.size() > 0)
+			{
+				sequences += sequence;
+				sequence.vertices.clear();
+			}
+			sequence.texture = texture;
+			sequence.channel = channel;
+		}
+	}
+
 	void Renderer::_updateLiningSequenceSwitch(bool force)
 	{
 		if (!this->_strikeThroughActive || force)
@@ -1715,14 +1997,14 @@ namespace atres
 				{
 					break;
 				}
-				// non-initial font might need character table update
-				if (initialFontName != this->_fontName && !this->_characters.hasKey(code) && this->_font->hasCharacter(code))
+				// non-initial font might not have loaded the character yet
+				this->_character = this->_glyphs->get(code);
+				if (this->_character == NULL && initialFontName != this->_fontName && this->_font->hasCharacter(code))
 				{
-					this->_characters = this->_font->getCharacters();
+					this->_character = this->_glyphs->get(code);
 				}
-				if (this->_characters.hasKey(code))
+				if (this->_character != NULL)
 				{
-					this->_character = this->_characters[code];
 					this->_scale = this->_fontScale * this->_textScale;
 					kerning = 0.0f;
 					if (this->_font != NULL)
@@ -1989,6 +2271,7 @@ namespace atres
 			firstFontName = this->getDefaultFontName();
 		}
 		this->analyzeText(tags.first().data, text);
+		this->_loadBorderCharacters(lines, tags);
 		this->_initializeFormatTags(tags);
 		this->_initializeRenderSequences();
 		this->_initializeLineProcessing(lines);
@@ -2001,6 +2284,8 @@ namespace atres
 		gvec2f rectSize;
 		int index = 0;
 		float italicSkewOffset = 0.0f;
+		TextEffect effect = TextEffect::None;
+		bool pending = false;
 		// basic text with borders, shadows and icons
 		for_iter (j, 0, this->_lines.size())
 		{
@@ -2041,34 +2326,58 @@ namespace atres
 							this->_renderRect = this->_iconFont->makeRenderRectangle(drawRect, area, this->_iconName);
 							if (this->_renderRect.src.w > 0.0f && this->_renderRect.src.h > 0.0f && this->_renderRect.dest.w > 0.0f && this->_renderRect.dest.h > 0.0f)
 							{
+								effect = TextEffect::None;
+								if (this->useEffectPasses)
+								{
+									if (this->_effectMode == EFFECT_MODE_SHADOW)
+									{
+										effect = TextEffect::Shadow;
+									}
+									else if (this->_effectMode == EFFECT_MODE_BORDER && (this->_iconFont->getBorderMode() == Font::BorderMode::Software ||
+										!this->_iconFont->hasBorderIcon(this->_iconName, this->_borderFontThickness)))
+									{
+										effect = TextEffect::Border;
+									}
+								}
+								this->_checkEffectSequenceSwitch(effect);
+								this->_checkRenderSequenceSwitch(this->_textSequence, this->_textSequences, this->_texture, this->_renderRect.channel);
 								this->_textSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
 								switch (this->_effectMode)
 								{
 								case EFFECT_MODE_SHADOW: // shadow
-									this->_renderRect.dest += this->_shadowOffset * (this->globalOffsets ? 1.0f : this->_scale);
-									this->_shadowSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+									if (effect == TextEffect::None)
+									{
+										this->_checkRenderSequenceSwitch(this->_shadowSequence, this->_shadowSequences, this->_texture, this->_renderRect.channel);
+										this->_renderRect.dest += this->_shadowOffset * (this->globalOffsets ? 1.0f : this->_scale);
+										this->_shadowSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+									}
 									break;
 								case EFFECT_MODE_BORDER: // border
 									if (this->_iconFont->getBorderMode() == Font::BorderMode::Software || !this->_iconFont->hasBorderIcon(this->_iconName, this->_borderFontThickness))
 									{
-										currentRect = this->_renderRect;
-										this->_renderRect.dest = currentRect.dest + gvec2f(-this->_borderThickness * sqrt05, -this->_borderThickness * sqrt05);
-										this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
-										this->_renderRect.dest = currentRect.dest + gvec2f(this->_borderThickness * sqrt05, -this->_borderThickness * sqrt05);
-										this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
-										this->_renderRect.dest = currentRect.dest + gvec2f(-this->_borderThickness * sqrt05, this->_borderThickness * sqrt05);
-										this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
-										this->_renderRect.dest = currentRect.dest + gvec2f(this->_borderThickness * sqrt05, this->_borderThickness * sqrt05);
-										this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
-										this->_renderRect.dest = currentRect.dest + gvec2f(0.0f, -this->_borderThickness);
-										this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
-										this->_renderRect.dest = currentRect.dest + gvec2f(-this->_borderThickness, 0.0f);
-										this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
-										this->_renderRect.dest = currentRect.dest + gvec2f(this->_borderThickness, 0.0f);
-										this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
-										this->_renderRect.dest = currentRect.dest + gvec2f(0.0f, this->_borderThickness);
-										this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
-										this->_borderSequence.multiplyAlpha = true;
+										// effect passes render the software border from the text sequence
+										if (effect == TextEffect::None)
+										{
+											this->_checkRenderSequenceSwitch(this->_borderSequence, this->_borderSequences, this->_texture, this->_renderRect.channel);
+											currentRect = this->_renderRect;
+											this->_renderRect.dest = currentRect.dest + gvec2f(-this->_borderThickness * sqrt05, -this->_borderThickness * sqrt05);
+											this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+											this->_renderRect.dest = currentRect.dest + gvec2f(this->_borderThickness * sqrt05, -this->_borderThickness * sqrt05);
+											this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+											this->_renderRect.dest = currentRect.dest + gvec2f(-this->_borderThickness * sqrt05, this->_borderThickness * sqrt05);
+											this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+											this->_renderRect.dest = currentRect.dest + gvec2f(this->_borderThickness * sqrt05, this->_borderThickness * sqrt05);
+											this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+											this->_renderRect.dest = currentRect.dest + gvec2f(0.0f, -this->_borderThickness);
+											this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+											this->_renderRect.dest = currentRect.dest + gvec2f(-this->_borderThickness, 0.0f);
+											this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+											this->_renderRect.dest = currentRect.dest + gvec2f(this->_borderThickness, 0.0f);
+											this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+											this->_renderRect.dest = currentRect.dest + gvec2f(0.0f, this->_borderThickness);
+											this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+											this->_borderSequence.multiplyAlpha = true;
+										}
 									}
 									else
 									{
@@ -2087,8 +2396,8 @@ namespace atres
 										drawRect.w += rectSize.x * 2.0f;
 										drawRect.h += rectSize.y * 2.0f;
 										this->_renderRect = this->_iconFont->makeBorderRenderRectangle(drawRect, area, this->_iconName, this->_borderFontThickness);
+										this->_checkRenderSequenceSwitch(this->_borderSequence, this->_borderSequences, this->_iconFont->getBorderTexture(this->_iconName, this->_borderFontThickness), this->_renderRect.channel);
 										this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
-										this->_borderSequence.texture = this->_iconFont->getBorderTexture(this->_iconName, this->_borderFontThickness);
 										this->_borderSequence.multiplyAlpha = false;
 									}
 									break;
@@ -2164,11 +2473,15 @@ namespace atres
 						// checking first formatting tag changes
 						this->_processFormatTags(this->_word.text, i);
 						// if character exists in current font
-						if (this->_characters.hasKey(this->_code) && !this->_hideActive)
+						this->_character = this->_glyphs->get(this->_code);
+						if (this->_character != NULL && !this->_hideActive)
 						{
+							if (this->_character->pending)
+							{
+								pending = true; // the character's image is not on a texture yet so the text has to be created again later
+							}
 							// checking the particular character
 							this->_scale = this->_fontScale * this->_textScale;
-							this->_character = this->_characters[this->_code];
 							this->_shadowOffset = this->shadowOffset * this->_textShadowOffset;
 							this->_borderThickness = this->borderThickness * this->_textBorderThickness;
 							this->_borderFontThickness = this->_borderThickness / this->_fontBaseScale;
@@ -2192,34 +2505,58 @@ namespace atres
 									if (this->_code != UNICODE_CHAR_SPACE && this->_code != UNICODE_CHAR_ZERO_WIDTH_SPACE)
 									{
 										this->_renderRect.dest.y -= this->_character->bearing.y * this->_scale;
+										effect = TextEffect::None;
+										if (this->useEffectPasses)
+										{
+											if (this->_effectMode == EFFECT_MODE_SHADOW)
+											{
+												effect = TextEffect::Shadow;
+											}
+											else if (this->_effectMode == EFFECT_MODE_BORDER && (this->_font->getBorderMode() == Font::BorderMode::Software ||
+												!this->_font->hasBorderCharacter(this->_code, this->_borderFontThickness)))
+											{
+												effect = TextEffect::Border;
+											}
+										}
+										this->_checkEffectSequenceSwitch(effect);
+										this->_checkRenderSequenceSwitch(this->_textSequence, this->_textSequences, this->_texture, this->_renderRect.channel);
 										this->_textSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
 										switch (this->_effectMode)
 										{
 										case EFFECT_MODE_SHADOW: // shadow
-											this->_renderRect.dest += this->_shadowOffset * (this->globalOffsets ? 1.0f : this->_scale);
-											this->_shadowSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+											if (effect == TextEffect::None)
+											{
+												this->_checkRenderSequenceSwitch(this->_shadowSequence, this->_shadowSequences, this->_texture, this->_renderRect.channel);
+												this->_renderRect.dest += this->_shadowOffset * (this->globalOffsets ? 1.0f : this->_scale);
+												this->_shadowSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+											}
 											break;
 										case EFFECT_MODE_BORDER: // border
 											if (this->_font->getBorderMode() == Font::BorderMode::Software || !this->_font->hasBorderCharacter(this->_code, this->_borderFontThickness))
 											{
-												currentRect = this->_renderRect;
-												this->_renderRect.dest = currentRect.dest + gvec2f(-this->_borderThickness * sqrt05, -this->_borderThickness * sqrt05);
-												this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
-												this->_renderRect.dest = currentRect.dest + gvec2f(this->_borderThickness * sqrt05, -this->_borderThickness * sqrt05);
-												this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
-												this->_renderRect.dest = currentRect.dest + gvec2f(-this->_borderThickness * sqrt05, this->_borderThickness * sqrt05);
-												this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
-												this->_renderRect.dest = currentRect.dest + gvec2f(this->_borderThickness * sqrt05, this->_borderThickness * sqrt05);
-												this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
-												this->_renderRect.dest = currentRect.dest + gvec2f(0.0f, -this->_borderThickness);
-												this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
-												this->_renderRect.dest = currentRect.dest + gvec2f(-this->_borderThickness, 0.0f);
-												this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
-												this->_renderRect.dest = currentRect.dest + gvec2f(this->_borderThickness, 0.0f);
-												this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
-												this->_renderRect.dest = currentRect.dest + gvec2f(0.0f, this->_borderThickness);
-												this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
-												this->_borderSequence.multiplyAlpha = true;
+												// effect passes render the software border from the text sequence
+												if (effect == TextEffect::None)
+												{
+													this->_checkRenderSequenceSwitch(this->_borderSequence, this->_borderSequences, this->_texture, this->_renderRect.channel);
+													currentRect = this->_renderRect;
+													this->_renderRect.dest = currentRect.dest + gvec2f(-this->_borderThickness * sqrt05, -this->_borderThickness * sqrt05);
+													this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+													this->_renderRect.dest = currentRect.dest + gvec2f(this->_borderThickness * sqrt05, -this->_borderThickness * sqrt05);
+													this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+													this->_renderRect.dest = currentRect.dest + gvec2f(-this->_borderThickness * sqrt05, this->_borderThickness * sqrt05);
+													this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+													this->_renderRect.dest = currentRect.dest + gvec2f(this->_borderThickness * sqrt05, this->_borderThickness * sqrt05);
+													this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+													this->_renderRect.dest = currentRect.dest + gvec2f(0.0f, -this->_borderThickness);
+													this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+													this->_renderRect.dest = currentRect.dest + gvec2f(-this->_borderThickness, 0.0f);
+													this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+													this->_renderRect.dest = currentRect.dest + gvec2f(this->_borderThickness, 0.0f);
+													this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+													this->_renderRect.dest = currentRect.dest + gvec2f(0.0f, this->_borderThickness);
+													this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
+													this->_borderSequence.multiplyAlpha = true;
+												}
 											}
 											else
 											{
@@ -2237,8 +2574,8 @@ namespace atres
 												drawRect.h += rectSize.y * 2.0f;
 												this->_renderRect = this->_font->makeBorderRenderRectangle(drawRect, area, this->_code, this->_borderFontThickness);
 												this->_renderRect.dest.y -= this->_character->bearing.y * this->_scale;
+												this->_checkRenderSequenceSwitch(this->_borderSequence, this->_borderSequences, this->_font->getBorderTexture(this->_code, this->_borderFontThickness), this->_renderRect.channel);
 												this->_borderSequence.addRenderRectangle(this->_renderRect, italicSkewOffset);
-												this->_borderSequence.texture = this->_font->getBorderTexture(this->_code, this->_borderFontThickness);
 												this->_borderSequence.multiplyAlpha = false;
 											}
 											break;
@@ -2327,18 +2664,121 @@ namespace atres
 			this->_borderSequence.vertices.clear();
 		}
 		this->_updateLiningSequenceSwitch(true);
+		// linings are moved into the symbol sequences where possible so they don't need separate render calls
+		this->_mergeLiningSequences(this->_textSequences, this->_textLiningSequences);
+		this->_mergeLiningSequences(this->_shadowSequences, this->_shadowLiningSequences);
+		this->_mergeLiningSequences(this->_borderSequences, this->_borderLiningSequences);
 		// clear data and optimizations
 		this->_lines.clear();
 		RenderText result;
+		result.pending = pending;
 		result.textSequences = this->optimizeSequences(this->_textSequences);
 		result.shadowSequences = this->optimizeSequences(this->_shadowSequences);
 		result.borderSequences = this->optimizeSequences(this->_borderSequences);
 		result.textLiningSequences = this->optimizeSequences(this->_textLiningSequences);
 		result.shadowLiningSequences = this->optimizeSequences(this->_shadowLiningSequences);
 		result.borderLiningSequences = this->optimizeSequences(this->_borderLiningSequences);
+		if (this->useVertexColors)
+		{
+			result.coloredSequences = this->createColoredSequences(result);
+			result.textSequences.clear();
+			result.shadowSequences.clear();
+			result.borderSequences.clear();
+			result.textLiningSequences.clear();
+			result.shadowLiningSequences.clear();
+			result.borderLiningSequences.clear();
+		}
 		return result;
 	}
 
+	bool Renderer::_findWhiteTexel(april::Texture* texture, gvec2f& uv)
+	{
+		foreach_map (hstr, Font*, it, this->fonts)
+		{
+			if (it->second->findWhiteTexel(texture, uv))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	void Renderer::_mergeLiningSequences(harray<RenderSequence>& sequences, harray<RenderLiningSequence>& liningSequences)
+	{
+		// searching the fonts for a white texel is slow so it's done only once per texture
+		hmap<april::Texture*, gvec2f> whiteTexels;
+		harray<april::Texture*> textures;
+		gvec2f uv;
+		foreach (RenderSequence, it, sequences)
+		{
+			if (!textures.has((*it).texture))
+			{
+				textures += (*it).texture;
+				if (this->_findWhiteTexel((*it).texture, uv))
+				{
+					whiteTexels[(*it).texture] = uv;
+				}
+			}
+		}
+		if (whiteTexels.size() == 0)
+		{
+			return;
+		}
+		april::Texture* texture = NULL;
+		int channel = -1;
+		RenderSequence sequence;
+		april::TexturedVertex vertex;
+		for_iter (i, 0, liningSequences.size())
+		{
+			// a texture already used with the same color is preferred so optimizeSequences() can merge the linings with the symbols
+			texture = NULL;
+			foreach (RenderSequence, it, sequences)
+			{
+				if ((*it).color == liningSequences[i].color && whiteTexels.hasKey((*it).texture))
+				{
+					texture = (*it).texture;
+					channel = (*it).channel;
+					break;
+				}
+			}
+			if (texture == NULL)
+			{
+				foreach (RenderSequence, it, sequences)
+				{
+					if (whiteTexels.hasKey((*it).texture))
+					{
+						texture = (*it).texture;
+						channel = (*it).channel;
+						break;
+					}
+				}
+			}
+			if (texture == NULL)
+			{
+				continue;
+			}
+			uv = whiteTexels[texture];
+			// the white area is written on all channels of a channel-packed texture
+			sequence.texture = texture;
+			sequence.channel = channel;
+			sequence.color = liningSequences[i].color;
+			sequence.multiplyAlpha = false;
+			sequence.vertices.clear();
+			vertex.u = uv.x;
+			vertex.v = uv.y;
+			foreach (april::PlainVertex, it, liningSequences[i].vertices)
+			{
+				vertex.x = (*it).x;
+				vertex.y = (*it).y;
+				vertex.z = (*it).z;
+				sequence.vertices += vertex;
+			}
+			sequences += sequence;
+			liningSequences.removeAt(i);
+			--i;
+		}
+	}
+
 	harray<RenderSequence> Renderer::optimizeSequences(harray<RenderSequence>& sequences)
 	{
 		harray<RenderSequence> result;
@@ -2348,7 +2788,9 @@ namespace atres
 			current = sequences.removeFirst();
 			for_iter (i, 0, sequences.size())
 			{
-				if (current.texture == sequences[i].texture && current.color.hex(true) == sequences[i].color.hex(true) && current.multiplyAlpha == sequences[i].multiplyAlpha)
+				if (current.texture == sequences[i].texture && current.channel == sequences[i].channel && current.color.hex(true) == sequences[i].color.hex(true) && current.multiplyAlpha == sequences[i].multiplyAlpha &&
+					current.effect == sequences[i].effect && current.effectColor == sequences[i].effectColor && current.effectOffset == sequences[i].effectOffset &&
+					current.effectThickness == sequences[i].effectThickness)
 				{
 					current.vertices += sequences[i].vertices;
 					sequences.removeAt(i);
@@ -2360,6 +2802,90 @@ namespace atres
 		return result;
 	}
 
+	harray<RenderColoredSequence> Renderer::createColoredSequences(const RenderText& renderText)
+	{
+		// alpha powers reproduce how _drawRenderText() applies the global alpha to each layer, text layers use the global alpha directly
+		harray<RenderColoredSequence> result;
+		harray<april::TexturedVertex> vertices;
+		int count = 0;
+		foreachc (RenderSequence, it, renderText.shadowSequences)
+		{
+			if ((*it).vertices.size() > 0 && (*it).texture != NULL)
+			{
+				grectf bounds = _makeBounds((*it).vertices);
+				_findColoredSequence(result, (*it).texture, (*it).channel, 0, bounds)->addVertices((*it).vertices, (*it).color, 1, bounds);
+			}
+		}
+		// effect passes cannot use a different transformation within the same render call so their vertices are created here
+		foreachc (RenderSequence, it, renderText.textSequences)
+		{
+			if ((*it).effect == TextEffect::Shadow && (*it).vertices.size() > 0 && (*it).texture != NULL)
+			{
+				count = _makeEffectOffsets((*it), _effectOffsets);
+				for_iter (i, 0, count)
+				{
+					_translateVertices((*it).vertices, _effectOffsets[i], vertices);
+					grectf bounds = _makeBounds(vertices);
+					_findColoredSequence(result, (*it).texture, (*it).channel, 0, bounds)->addVertices(vertices, (*it).effectColor, 1, bounds);
+				}
+			}
+		}
+		foreachc (RenderLiningSequence, it, renderText.shadowLiningSequences)
+		{
+			if ((*it).vertices.size() > 0)
+			{
+				grectf bounds = _makeBounds((*it).vertices);
+				_findColoredSequence(result, NULL, -1, 1, bounds)->addLiningVertices((*it).vertices, (*it).color, 1, bounds);
+			}
+		}
+		foreachc (RenderSequence, it, renderText.borderSequences)
+		{
+			if ((*it).vertices.size() > 0 && (*it).texture != NULL)
+			{
+				grectf bounds = _makeBounds((*it).vertices);
+				_findColoredSequence(result, (*it).texture, (*it).channel, 2, bounds)->addVertices((*it).vertices, (*it).color, ((*it).multiplyAlpha ? 2 : 1), bounds);
+			}
+		}
+		foreachc (RenderSequence, it, renderText.textSequences)
+		{
+			if ((*it).effect == TextEffect::Border && (*it).vertices.size() > 0 && (*it).texture != NULL)
+			{
+				count = _makeEffectOffsets((*it), _effectOffsets);
+				for_iter (i, 0, count)
+				{
+					_translateVertices((*it).vertices, _effectOffsets[i], vertices);
+					grectf bounds = _makeBounds(vertices);
+					_findColoredSequence(result, (*it).texture, (*it).channel, 2, bounds)->addVertices(vertices, (*it).effectColor, 2, bounds);
+				}
+			}
+		}
+		foreachc (RenderLiningSequence, it, renderText.borderLiningSequences)
+		{
+			if ((*it).vertices.size() > 0)
+			{
+				grectf bounds = _makeBounds((*it).vertices);
+				_findColoredSequence(result, NULL, -1, 3, bounds)->addLiningVertices((*it).vertices, (*it).color, 1, bounds);
+			}
+		}
+		foreachc (RenderSequence, it, renderText.textSequences)
+		{
+			if ((*it).vertices.size() > 0 && (*it).texture != NULL)
+			{
+				grectf bounds = _makeBounds((*it).vertices);
+				_findColoredSequence(result, (*it).texture, (*it).channel, 4, bounds)->addVertices((*it).vertices, april::Color((*it).color, 255), 1, bounds);
+			}
+		}
+		foreachc (RenderLiningSequence, it, renderText.textLiningSequences)
+		{
+			if ((*it).vertices.size() > 0)
+			{
+				grectf bounds = _makeBounds((*it).vertices);
+				_findColoredSequence(result, NULL, -1, 5, bounds)->addLiningVertices((*it).vertices, april::Color((*it).color, 255), 1, bounds);
+			}
+		}
+		return result;
+	}
+
 	harray<RenderLiningSequence> Renderer::optimizeSequences(harray<RenderLiningSequence>& sequences)
 	{
 		harray<RenderLiningSequence> result;
@@ -2381,30 +2907,110 @@ namespace atres
 		return result;
 	}
 
+	void Renderer::_uploadTextures()
+	{
+		foreach_map (hstr, Font*, it, this->fonts)
+		{
+			it->second->uploadTextures();
+		}
+	}
+
+	void Renderer::_markTexturesUsed(const RenderText& renderText)
+	{
+		// most fonts don't depend on texture usage so all of this is skipped for them
+		if (!this->_textureUsageFontsValid)
+		{
+			this->_textureUsageFonts.clear();
+			harray<Font*> fonts = this->fonts.values().removedDuplicates(); // aliases
+			foreach (Font*, it, fonts)
+			{
+				if ((*it)->isTextureUsageTracked())
+				{
+					this->_textureUsageFonts += (*it);
+				}
+			}
+			this->_textureUsageFontsValid = true;
+		}
+		if (this->_textureUsageFonts.size() == 0)
+		{
+			return;
+		}
+		this->_lastUsedTexture = NULL;
+		foreachc (RenderSequence, it, renderText.textSequences)
+		{
+			this->_markTextureUsed((*it).texture);
+		}
+		foreachc (RenderSequence, it, renderText.borderSequences)
+		{
+			this->_markTextureUsed((*it).texture);
+		}
+		foreachc (RenderColoredSequence, it, renderText.coloredSequences)
+		{
+			this->_markTextureUsed((*it).texture);
+		}
+	}
+
+	void Renderer::_markTextureUsed(april::Texture* texture)
+	{
+		if (texture != NULL && texture != this->_lastUsedTexture)
+		{
+			this->_lastUsedTexture = texture;
+			// pages of a shared atlas pool are used by several fonts
+			foreach (Font*, it, this->_textureUsageFonts)
+			{
+				(*it)->markTextureUsed(texture);
+			}
+		}
+	}
+
 	void Renderer::_drawRenderText(RenderText& renderText, const april::Color& color)
 	{
+		// textures that are in use must not be recycled by fonts before the end of the frame
+		this->_markTexturesUsed(renderText);
+		if (!this->batching)
+		{
+			this->_uploadTextures(); // when batching, this is done in flush()
+		}
+		foreach (RenderColoredSequence, it, renderText.coloredSequences)
+		{
+			this->_drawRenderColoredSequence((*it), color);
+		}
 		foreach (RenderSequence, it, renderText.shadowSequences)
 		{
-			this->_drawRenderSequence((*it), april::Color((*it).color, (unsigned char)((*it).color.a * color.a_f())));
+			this->_drawRenderSequence((*it), april::Color((*it).color, (unsigned char)((*it).color.a * color.a_f())), EFFECT_MODE_SHADOW);
+		}
+		foreach (RenderSequence, it, renderText.textSequences)
+		{
+			if ((*it).effect == TextEffect::Shadow)
+			{
+				this->_drawRenderSequenceEffect((*it), april::Color((*it).effectColor, (unsigned char)((*it).effectColor.a * color.a_f())), EFFECT_MODE_SHADOW);
+			}
 		}
 		foreach (RenderLiningSequence, it, renderText.shadowLiningSequences)
 		{
-			this->_drawRenderLiningSequence((*it), april::Color((*it).color, (unsigned char)((*it).color.a * color.a_f())));
+			this->_drawRenderLiningSequence((*it), april::Color((*it).color, (unsigned char)((*it).color.a * color.a_f())), EFFECT_MODE_SHADOW);
 		}
 		foreach (RenderSequence, it, renderText.borderSequences)
 		{
 			if ((*it).multiplyAlpha)
 			{
-				this->_drawRenderSequence((*it), april::Color((*it).color, (unsigned char)((*it).color.a * color.a_f() * color.a_f())));
+				this->_drawRenderSequence((*it), april::Color((*it).color, (unsigned char)((*it).color.a * color.a_f() * color.a_f())), EFFECT_MODE_BORDER);
 			}
 			else
 			{
-				this->_drawRenderSequence((*it), april::Color((*it).color, (unsigned char)((*it).color.a * color.a_f())));
+				this->_drawRenderSequence((*it), april::Color((*it).color, (unsigned char)((*it).color.a * color.a_f())), EFFECT_MODE_BORDER);
+			}
+		}
+		foreach (RenderSequence, it, renderText.textSequences)
+		{
+			if ((*it).effect == TextEffect::Border)
+			{
+				this->_drawRenderSequenceEffect((*it), april::Color((*it).effectColor, (unsigned char)((*it).effectColor.a * color.a_f() * color.a_f())), EFFECT_MODE_BORDER);
 			}
 		}
 		foreach (RenderLiningSequence, it, renderText.borderLiningSequences)
 		{
-			this->_drawRenderLiningSequence((*it), april::Color((*it).color, (unsigned char)((*it).color.a * color.a_f())));
+			this->_drawRenderLiningSequence((*it), april::Color((*it).color, (unsigned char)((*it).color.a * color.a_f())), EFFECT_MODE_BORDER);
 		}
 		foreach (RenderSequence, it, renderText.textSequences)
 		{
@@ -2424,42 +3030,243 @@ namespace atres
 			april::rendersys->render(april::RenderOperation::LineList, (april::PlainVertex*)v, v.size(), polygonColor);
 			v.clear();
 #endif
-			this->_drawRenderSequence((*it), april::Color((*it).color, color.a));
+			this->_drawRenderSequence((*it), april::Color((*it).color, color.a), EFFECT_MODE_NORMAL);
 		}
 		foreach (RenderLiningSequence, it, renderText.textLiningSequences)
 		{
-			this->_drawRenderLiningSequence((*it), april::Color((*it).color, color.a));
+			this->_drawRenderLiningSequence((*it), april::Color((*it).color, color.a), EFFECT_MODE_NORMAL);
 		}
 	}
 
-	void Renderer::_drawRenderSequence(RenderSequence& sequence, const april::Color& color)
+	void Renderer::_drawRenderSequence(RenderSequence& sequence, const april::Color& color, int layer)
 	{
 		if (sequence.vertices.size() == 0 || sequence.texture == NULL || color.a == 0)
 		{
 			return;
 		}
-		april::rendersys->setTexture(sequence.texture);
-		april::rendersys->setBlendMode(april::BlendMode::Alpha);
-		if (sequence.texture->getFormat() == april::Image::Format::Alpha)
+		if (this->batching)
 		{
-			april::rendersys->setColorMode(april::ColorMode::AlphaMap);
+			grectf bounds = _makeBounds(sequence.vertices);
+			this->_findBatch(sequence.texture, sequence.channel, color, layer, bounds)->addVertices(sequence.vertices, bounds);
+			return;
 		}
-		else
+		if (!this->_setTexture(sequence.texture, sequence.channel))
 		{
-			april::rendersys->setColorMode(april::ColorMode::Multiply);
+			return;
 		}
+		april::rendersys->setBlendMode(april::BlendMode::Alpha);
 		april::rendersys->render(april::RenderOperation::TriangleList, (april::TexturedVertex*)sequence.vertices, sequence.vertices.size(), color);
+		++this->drawCallCount;
+	}
+
+	void Renderer::_drawRenderSequenceEffect(RenderSequence& sequence, const april::Color& color, int layer)
+	{
+		if (sequence.vertices.size() == 0 || sequence.texture == NULL || color.a == 0)
+		{
+			return;
+		}
+		int count = _makeEffectOffsets(sequence, _effectOffsets);
+		if (this->batching)
+		{
+			// the render state cannot change within a batch so the offset geometry is created on the fly
+			_effectSequence.texture = sequence.texture;
+			_effectSequence.channel = sequence.channel;
+			for_iter (i, 0, count)
+			{
+				_translateVertices(sequence.vertices, _effectOffsets[i], _effectSequence.vertices);
+				this->_drawRenderSequence(_effectSequence, color, layer);
+			}
+			return;
+		}
+		gmat4 modelviewMatrix = april::rendersys->getModelviewMatrix();
+		for_iter (i, 0, count)
+		{
+			april::rendersys->setModelviewMatrix(modelviewMatrix);
+			april::rendersys->translate(_effectOffsets[i].x, _effectOffsets[i].y);
+			this->_drawRenderSequence(sequence, color, layer);
+		}
+		april::rendersys->setModelviewMatrix(modelviewMatrix);
 	}
 
-	void Renderer::_drawRenderLiningSequence(RenderLiningSequence& sequence, const april::Color& color)
+	void Renderer::_drawRenderLiningSequence(RenderLiningSequence& sequence, const april::Color& color, int layer)
 	{
 		if (sequence.vertices.size() == 0 || color.a == 0)
 		{
 			return;
 		}
+		if (this->batching)
+		{
+			grectf bounds = _makeBounds(sequence.vertices);
+			this->_findBatch(NULL, -1, color, layer, bounds)->addLiningVertices(sequence.vertices, bounds);
+			return;
+		}
 		april::rendersys->setBlendMode(april::BlendMode::Alpha);
 		april::rendersys->setColorMode(april::ColorMode::Multiply);
 		april::rendersys->render(april::RenderOperation::TriangleList, (april::PlainVertex*)sequence.vertices, sequence.vertices.size(), color);
+		++this->drawCallCount;
+	}
+
+	void Renderer::_drawRenderColoredSequence(RenderColoredSequence& sequence, const april::Color& color)
+	{
+		if (color.a == 0 || (sequence.vertices.size() == 0 && sequence.liningVertices.size() == 0))
+		{
+			return;
+		}
+		// the vertices already have the base colors so a copy is only needed if the global alpha has to be applied
+		harray<april::ColoredTexturedVertex>* vertices = &sequence.vertices;
+		harray<april::ColoredVertex>* liningVertices = &sequence.liningVertices;
+		if (color.a < 255)
+		{
+			if (sequence.texture != NULL)
+			{
+				_applyAlpha(sequence.vertices, sequence.colors, sequence.alphaPowers, color.a_f(), _coloredVertices);
+				vertices = &_coloredVertices;
+			}
+			else
+			{
+				_applyAlpha(sequence.liningVertices, sequence.colors, sequence.alphaPowers, color.a_f(), _coloredLiningVertices);
+				liningVertices = &_coloredLiningVertices;
+			}
+		}
+		if (this->batching)
+		{
+			RenderBatch* batch = this->_findBatch(sequence.texture, sequence.channel, april::Color::White, 0, sequence.bounds, true);
+			if (sequence.texture != NULL)
+			{
+				batch->addColoredVertices(*vertices, sequence.bounds);
+			}
+			else
+			{
+				batch->addColoredLiningVertices(*liningVertices, sequence.bounds);
+			}
+			return;
+		}
+		april::rendersys->setBlendMode(april::BlendMode::Alpha);
+		if (sequence.texture != NULL)
+		{
+			if (!this->_setTexture(sequence.texture, sequence.channel))
+			{
+				return;
+			}
+			april::rendersys->render(april::RenderOperation::TriangleList, (april::ColoredTexturedVertex*)(*vertices), vertices->size());
+		}
+		else
+		{
+			april::rendersys->setColorMode(april::ColorMode::Multiply);
+			april::rendersys->render(april::RenderOperation::TriangleList, (april::ColoredVertex*)(*liningVertices), liningVertices->size());
+		}
+		++this->drawCallCount;
+	}
+
+	bool Renderer::_setTexture(april::Texture* texture, int channel)
+	{
+		if (channel >= 0)
+		{
+			// the stock color modes cannot select a channel so the symbols are sampled from a copy that holds the channel as alpha
+			april::Texture* channelTexture = NULL;
+			foreach_map (hstr, Font*, it, this->fonts)
+			{
+				channelTexture = it->second->getChannelTexture(texture, channel);
+				if (channelTexture != NULL)
+				{
+					break;
+				}
+			}
+			if (channelTexture == NULL)
+			{
+				return false; // the packed texture was replaced in this frame, sampling all of its channels would render garbage
+			}
+			texture = channelTexture;
+		}
+		april::rendersys->setTexture(texture);
+		if (texture->getFormat() == april::Image::Format::Alpha)
+		{
+			april::rendersys->setColorMode(april::ColorMode::AlphaMap);
+		}
+		else
+		{
+			april::rendersys->setColorMode(april::ColorMode::Multiply);
+		}
+		return true;
+	}
+
+	RenderBatch* Renderer::_findBatch(april::Texture* texture, int channel, const april::Color& color, int layer, cgrectf bounds, bool colored)
+	{
+		// an older batch can only be reused if no batch queued after it overlaps the new geometry, otherwise painter's order would be broken
+		for (int i = this->_batchCount - 1; i >= 0; --i)
+		{
+			if (this->_batches[i].isMergeable(texture, channel, color, layer, colored))
+			{
+				return &this->_batches[i];
+			}
+			if (this->_batches[i].bounds.intersects(bounds))
+			{
+				break;
+			}
+		}
+		if (this->_batchCount >= this->_batches.size())
+		{
+			this->_batches += RenderBatch();
+		}
+		RenderBatch* batch = &this->_batches[this->_batchCount];
+		batch->reset(texture, channel, color, layer, colored);
+		++this->_batchCount;
+		return batch;
+	}
+
+	void Renderer::_renderBatch(RenderBatch& batch)
+	{
+		april::rendersys->setBlendMode(april::BlendMode::Alpha);
+		if (batch.texture != NULL)
+		{
+			if (!this->_setTexture(batch.texture, batch.channel))
+			{
+				return;
+			}
+			if (batch.colored)
+			{
+				april::rendersys->render(april::RenderOperation::TriangleList, (april::ColoredTexturedVertex*)batch.coloredVertices, batch.coloredVertices.size());
+			}
+			else
+			{
+				april::rendersys->render(april::RenderOperation::TriangleList, (april::TexturedVertex*)batch.vertices, batch.vertices.size(), batch.color);
+			}
+		}
+		else
+		{
+			april::rendersys->setColorMode(april::ColorMode::Multiply);
+			if (batch.colored)
+			{
+				april::rendersys->render(april::RenderOperation::TriangleList, (april::ColoredVertex*)batch.coloredLiningVertices, batch.coloredLiningVertices.size());
+			}
+			else
+			{
+				april::rendersys->render(april::RenderOperation::TriangleList, (april::PlainVertex*)batch.liningVertices, batch.liningVertices.size(), batch.color);
+			}
+		}
+		++this->drawCallCount;
+	}
+
+	void Renderer::update()
+	{
+		++this->frame;
+	}
+
+	void Renderer::flush()
+	{
+		this->_flushBatches();
+		this->update();
+	}
+
+	void Renderer::_flushBatches()
+	{
+		this->_uploadTextures();
+		for_iter (i, 0, this->_batchCount)
+		{
+			this->_renderBatch(this->_batches[i]);
+		}
+		this->flushedBatchCount = this->_batchCount;
+		this->_batchCount = 0;
 	}
 
 	bool Renderer::_checkTextures()
@@ -2488,6 +3295,14 @@ namespace atres
 				return false;
 			}
 		}
+		foreach (RenderColoredSequence, it, this->_cacheEntryText.value.coloredSequences)
+		{
+			if ((*it).texture != NULL && !(*it).texture->isUploaded())
+			{
+				this->clearCache(); // font textures were deleted somewhere for some reason (e.g. Android's onPause), clear the cacheText
+				return false;
+			}
+		}
 		return true;
 	}
 	
@@ -6,19 +6,58 @@
 /// This program is free software; you can redistribute it and/or modify it under
 /// the terms of the BSD license: http://opensource.org/licenses/BSD-3-Clause
 
+#include <string.h>
+
 #include <april/Color.h>
+#include <april/Image.h>
 #include <april/RenderSystem.h>
 #include <hltypes/hstring.h>
 
 #include "Utility.h"
 
+#define LINING_MERGE_TOLERANCE 0.01f
+#define GLYPH_PAGE_SIZE 256
+#define GLYPH_PAGE_COUNT 256 // covers the Basic Multilingual Plane
+
 namespace atres
 {
 	static april::TexturedVertex _tVertices[6];
 	static april::PlainVertex _pVertices[6];
+	static april::ColoredTexturedVertex _ctVertex;
+	static april::ColoredVertex _cVertex;
 	static float _top = 0.0f;
 	static float _bottom = 0.0f;
 
+	static void _writeChannelArea(april::Texture* texture, april::Image* image, int channel, cgrecti rect)
+	{
+		// the channel becomes the alpha of white texels, the rest of the image stays as it is
+		bool alpha = (texture->getFormat() == april::Image::Format::Alpha);
+		april::Image* area = april::Image::create(rect.w, rect.h, (alpha ? april::Color::Clear : april::Color(april::Color::White, 0)),
+			(alpha ? april::Image::Format::Alpha : april::Image::Format::RGBA));
+		int srcBpp = image->format.getBpp();
+		int destBpp = area->format.getBpp();
+		const unsigned char* src = NULL;
+		unsigned char* dest = area->data + destBpp - 1;
+		for_iter (j, 0, rect.h)
+		{
+			src = image->data + ((rect.y + j) * image->w + rect.x) * srcBpp + channel;
+			for_iter (i, 0, rect.w)
+			{
+				dest[i * destBpp] = src[i * srcBpp];
+			}
+			dest += rect.w * destBpp;
+		}
+		texture->write(0, 0, rect.w, rect.h, rect.x, rect.y, area);
+		delete area;
+	}
+
+	static grectf _unite(cgrectf a, cgrectf b)
+	{
+		float left = hmin(a.left(), b.left());
+		float top = hmin(a.top(), b.top());
+		return grectf(left, top, hmax(a.right(), b.right()) - left, hmax(a.bottom(), b.bottom()) - top);
+	}
+
 	HL_ENUM_CLASS_DEFINE(Horizontal,
 	(
 		HL_ENUM_DEFINE(Horizontal, Left);
@@ -73,7 +112,9 @@ namespace atres
 		HL_ENUM_DEFINE(TextEffect, Border);
 	));
 
-	RectDefinition::RectDefinition()
+	RectDefinition::RectDefinition() :
+		textureIndex(-1),
+		channel(-1)
 	{
 	}
 
@@ -89,7 +130,8 @@ namespace atres
 
 	CharacterDefinition::CharacterDefinition() :
 		SymbolDefinition(),
-		offsetY(0.0f)
+		offsetY(0.0f),
+		pending(false)
 	{
 	}
 
@@ -99,13 +141,104 @@ namespace atres
 		this->borderThickness = borderThickness;
 	}
 
-	RenderRectangle::RenderRectangle()
+	Glyph::Glyph() :
+		advance(0.0f),
+		offsetY(0.0f),
+		texture(NULL),
+		channel(-1),
+		valid(false),
+		pending(false)
+	{
+	}
+
+	GlyphTable::GlyphTable()
+	{
+		this->pages = new Glyph*[GLYPH_PAGE_COUNT];
+		memset(this->pages, 0, GLYPH_PAGE_COUNT * sizeof(Glyph*));
+	}
+
+	GlyphTable::~GlyphTable()
+	{
+		this->clear();
+		delete[] this->pages;
+	}
+
+	const Glyph* GlyphTable::get(unsigned int charCode) const
+	{
+		if (charCode < GLYPH_PAGE_SIZE * GLYPH_PAGE_COUNT)
+		{
+			const Glyph* page = this->pages[charCode / GLYPH_PAGE_SIZE];
+			if (page != NULL && page[charCode % GLYPH_PAGE_SIZE].valid)
+			{
+				return &page[charCode % GLYPH_PAGE_SIZE];
+			}
+			return NULL;
+		}
+		hmap<unsigned int, Glyph>::const_iterator it = this->sparseGlyphs.find(charCode);
+		return (it != this->sparseGlyphs.end() ? &it->second : NULL);
+	}
+
+	Glyph* GlyphTable::add(unsigned int charCode)
+	{
+		Glyph* glyph = NULL;
+		if (charCode < GLYPH_PAGE_SIZE * GLYPH_PAGE_COUNT)
+		{
+			Glyph*& page = this->pages[charCode / GLYPH_PAGE_SIZE];
+			if (page == NULL)
+			{
+				page = new Glyph[GLYPH_PAGE_SIZE];
+			}
+			glyph = &page[charCode % GLYPH_PAGE_SIZE];
+		}
+		else
+		{
+			glyph = &this->sparseGlyphs[charCode];
+		}
+		glyph->valid = true;
+		return glyph;
+	}
+
+	void GlyphTable::remove(unsigned int charCode)
+	{
+		if (charCode < GLYPH_PAGE_SIZE * GLYPH_PAGE_COUNT)
+		{
+			Glyph* page = this->pages[charCode / GLYPH_PAGE_SIZE];
+			if (page != NULL)
+			{
+				page[charCode % GLYPH_PAGE_SIZE] = Glyph();
+			}
+		}
+		else
+		{
+			this->sparseGlyphs.removeKey(charCode);
+		}
+	}
+
+	void GlyphTable::clear()
+	{
+		for_iter (i, 0, GLYPH_PAGE_COUNT)
+		{
+			if (this->pages[i] != NULL)
+			{
+				delete[] this->pages[i];
+				this->pages[i] = NULL;
+			}
+		}
+		this->sparseGlyphs.clear();
+	}
+
+	RenderRectangle::RenderRectangle() :
+		channel(-1)
 	{
 	}
 
 	RenderSequence::RenderSequence() :
 		texture(NULL),
-		multiplyAlpha(false)
+		channel(-1),
+		multiplyAlpha(false),
+		effect(TextEffect::None),
+		effectColor(april::Color::Clear),
+		effectThickness(0.0f)
 	{
 	}
 
@@ -136,7 +269,9 @@ namespace atres
 	{
 		_top = rect.top();
 		_bottom = rect.bottom();
-		if (this->vertices.size() > 0 && this->vertices[this->vertices.size() - 1].y == _bottom && this->vertices[this->vertices.size() - 3].y == _top)
+		// only rectangles that continue the previous one on the same line are merged into a single quad, gaps have to stay gaps
+		if (this->vertices.size() > 0 && this->vertices[this->vertices.size() - 1].y == _bottom && this->vertices[this->vertices.size() - 3].y == _top &&
+			rect.left() >= this->vertices[this->vertices.size() - 6].x && rect.left() <= this->vertices[this->vertices.size() - 1].x + LINING_MERGE_TOLERANCE)
 		{
 			this->vertices[this->vertices.size() - 1].x = this->vertices[this->vertices.size() - 3].x = this->vertices[this->vertices.size() - 5].x = rect.right();
 		}
@@ -150,6 +285,102 @@ namespace atres
 		}
 	}
 
+	RenderColoredSequence::RenderColoredSequence() :
+		texture(NULL),
+		channel(-1),
+		pass(0)
+	{
+	}
+
+	void RenderColoredSequence::addVertices(const harray<april::TexturedVertex>& vertices, const april::Color& color, unsigned char alphaPower, cgrectf bounds)
+	{
+		this->bounds = (this->vertices.size() > 0 ? _unite(this->bounds, bounds) : bounds);
+		_ctVertex.color = april::rendersys->getNativeColorUInt(color);
+		foreachc (april::TexturedVertex, it, vertices)
+		{
+			_ctVertex.x = (*it).x;
+			_ctVertex.y = (*it).y;
+			_ctVertex.z = (*it).z;
+			_ctVertex.u = (*it).u;
+			_ctVertex.v = (*it).v;
+			this->vertices += _ctVertex;
+		}
+		this->colors.add(color, vertices.size());
+		this->alphaPowers.add(alphaPower, vertices.size());
+	}
+
+	void RenderColoredSequence::addLiningVertices(const harray<april::PlainVertex>& vertices, const april::Color& color, unsigned char alphaPower, cgrectf bounds)
+	{
+		this->bounds = (this->liningVertices.size() > 0 ? _unite(this->bounds, bounds) : bounds);
+		_cVertex.color = april::rendersys->getNativeColorUInt(color);
+		foreachc (april::PlainVertex, it, vertices)
+		{
+			_cVertex.x = (*it).x;
+			_cVertex.y = (*it).y;
+			_cVertex.z = (*it).z;
+			this->liningVertices += _cVertex;
+		}
+		this->colors.add(color, vertices.size());
+		this->alphaPowers.add(alphaPower, vertices.size());
+	}
+
+	RenderBatch::RenderBatch() :
+		texture(NULL),
+		channel(-1),
+		layer(0),
+		colored(false)
+	{
+	}
+
+	bool RenderBatch::isEmpty() const
+	{
+		return (this->vertices.size() == 0 && this->liningVertices.size() == 0 && this->coloredVertices.size() == 0 && this->coloredLiningVertices.size() == 0);
+	}
+
+	void RenderBatch::reset(april::Texture* texture, int channel, const april::Color& color, int layer, bool colored)
+	{
+		this->texture = texture;
+		this->channel = channel;
+		this->color = color;
+		this->layer = layer;
+		this->colored = colored;
+		this->bounds.set(0.0f, 0.0f, 0.0f, 0.0f);
+		// clear() keeps the allocated memory so batches can be reused every frame without reallocation
+		this->vertices.clear();
+		this->liningVertices.clear();
+		this->coloredVertices.clear();
+		this->coloredLiningVertices.clear();
+	}
+
+	bool RenderBatch::isMergeable(april::Texture* texture, int channel, const april::Color& color, int layer, bool colored) const
+	{
+		return (this->texture == texture && this->channel == channel && this->colored == colored && (colored || (this->color == color && this->layer == layer)));
+	}
+
+	void RenderBatch::addVertices(const harray<april::TexturedVertex>& vertices, cgrectf bounds)
+	{
+		this->bounds = (!this->isEmpty() ? _unite(this->bounds, bounds) : bounds);
+		this->vertices.add(vertices);
+	}
+
+	void RenderBatch::addLiningVertices(const harray<april::PlainVertex>& vertices, cgrectf bounds)
+	{
+		this->bounds = (!this->isEmpty() ? _unite(this->bounds, bounds) : bounds);
+		this->liningVertices.add(vertices);
+	}
+
+	void RenderBatch::addColoredVertices(const harray<april::ColoredTexturedVertex>& vertices, cgrectf bounds)
+	{
+		this->bounds = (!this->isEmpty() ? _unite(this->bounds, bounds) : bounds);
+		this->coloredVertices.add(vertices);
+	}
+
+	void RenderBatch::addColoredLiningVertices(const harray<april::ColoredVertex>& vertices, cgrectf bounds)
+	{
+		this->bounds = (!this->isEmpty() ? _unite(this->bounds, bounds) : bounds);
+		this->coloredLiningVertices.add(vertices);
+	}
+
 	RenderWord::RenderWord() :
 		start(0),
 		count(0),
@@ -169,10 +400,44 @@ namespace atres
 	{
 	}
 	
-	RenderText::RenderText()
+	RenderText::RenderText() :
+		pending(false)
 	{
 	}
 
+	bool RenderText::hasTexture(april::Texture* texture) const
+	{
+		foreachc (RenderSequence, it, this->textSequences)
+		{
+			if ((*it).texture == texture)
+			{
+				return true;
+			}
+		}
+		foreachc (RenderSequence, it, this->shadowSequences)
+		{
+			if ((*it).texture == texture)
+			{
+				return true;
+			}
+		}
+		foreachc (RenderSequence, it, this->borderSequences)
+		{
+			if ((*it).texture == texture)
+			{
+				return true;
+			}
+		}
+		foreachc (RenderColoredSequence, it, this->coloredSequences)
+		{
+			if ((*it).texture == texture)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
 	HL_ENUM_CLASS_DEFINE(FormatTag::Type,
 	(
 		HL_ENUM_DEFINE(FormatTag::Type, Escape);
@@ -201,18 +466,43 @@ namespace atres
 
 	TextureContainer::TextureContainer() :
 		texture(NULL),
-		penX(0),
-		penY(0),
-		rowHeight(0)
+		image(NULL),
+		dirtyRect(0, 0, 0, 0),
+		whiteRect(0, 0, 0, 0),
+		usedArea(0),
+		lastUsedFrame(0),
+		page(NULL),
+		owner(NULL),
+		channel(-1),
+		channelTexture(NULL)
 	{
+		this->skyline += gvec2i(0, 0);
 	}
 
 	TextureContainer::~TextureContainer()
 	{
+		this->destroyChannelTexture();
+		if (this->page != NULL) // the texture belongs to a shared atlas page, the reserved areas can be used by other fonts
+		{
+			foreach (grecti, it, this->pageRects)
+			{
+				this->page->freeRects += (*it);
+				this->page->usedArea -= (*it).w * (*it).h;
+			}
+			return;
+		}
+		if (this->owner != NULL) // the texture belongs to another channel
+		{
+			return;
+		}
 		if (this->texture != NULL)
 		{
 			april::rendersys->destroyTexture(this->texture);
 		}
+		if (this->image != NULL)
+		{
+			delete this->image;
+		}
 	}
 
 	TextureContainer* TextureContainer::createNew() const
@@ -220,6 +510,157 @@ namespace atres
 		return new TextureContainer();
 	}
 
+	bool TextureContainer::findPosition(int width, int height, gvec2i& position) const
+	{
+		if (this->texture == NULL)
+		{
+			return false;
+		}
+		int textureWidth = this->texture->getWidth();
+		int textureHeight = this->texture->getHeight();
+		int bestY = textureHeight;
+		int y = 0;
+		int size = this->skyline.size();
+		int j = 0;
+		for_iter (i, 0, size)
+		{
+			if (this->skyline[i].x + width > textureWidth)
+			{
+				break;
+			}
+			// the rectangle rests on the highest segment it spans
+			y = this->skyline[i].y;
+			for (j = i + 1; j < size && this->skyline[j].x < this->skyline[i].x + width; ++j)
+			{
+				y = hmax(y, this->skyline[j].y);
+			}
+			if (y + height <= textureHeight && y < bestY)
+			{
+				bestY = y;
+				position.set(this->skyline[i].x, y);
+			}
+		}
+		return (bestY < textureHeight);
+	}
+
+	void TextureContainer::reserve(cgrecti rect)
+	{
+		int right = rect.x + rect.w;
+		int rightY = 0;
+		harray<gvec2i> skyline;
+		foreach (gvec2i, it, this->skyline)
+		{
+			if ((*it).x < rect.x)
+			{
+				skyline += (*it);
+			}
+			if ((*it).x <= right)
+			{
+				rightY = (*it).y; // height of the outline where the rectangle ends
+			}
+		}
+		skyline += gvec2i(rect.x, rect.y + rect.h);
+		if (this->texture == NULL || right < this->texture->getWidth())
+		{
+			skyline += gvec2i(right, rightY);
+		}
+		foreach (gvec2i, it, this->skyline)
+		{
+			if ((*it).x > right)
+			{
+				skyline += (*it);
+			}
+		}
+		// merge neighboring segments of the same height
+		this->skyline.clear();
+		foreach (gvec2i, it, skyline)
+		{
+			if (this->skyline.size() == 0 || this->skyline.last().y != (*it).y)
+			{
+				this->skyline += (*it);
+			}
+		}
+		this->usedArea += rect.w * rect.h;
+	}
+
+	void TextureContainer::addDirtyRect(cgrecti rect)
+	{
+		if (this->dirtyRect.w > 0 && this->dirtyRect.h > 0)
+		{
+			int left = hmin(this->dirtyRect.x, rect.x);
+			int top = hmin(this->dirtyRect.y, rect.y);
+			this->dirtyRect.set(left, top, hmax(this->dirtyRect.right(), rect.right()) - left, hmax(this->dirtyRect.bottom(), rect.bottom()) - top);
+		}
+		else
+		{
+			this->dirtyRect = rect;
+		}
+	}
+
+	bool TextureContainer::upload()
+	{
+		if (this->image == NULL || this->texture == NULL || this->dirtyRect.w <= 0 || this->dirtyRect.h <= 0)
+		{
+			return false;
+		}
+		this->texture->write(this->dirtyRect.x, this->dirtyRect.y, this->dirtyRect.w, this->dirtyRect.h, this->dirtyRect.x, this->dirtyRect.y, this->image);
+		if (this->channelTexture != NULL)
+		{
+			_writeChannelArea(this->channelTexture, this->image, this->channel, this->dirtyRect);
+		}
+		this->dirtyRect.set(0, 0, 0, 0);
+		return true;
+	}
+
+	april::Texture* TextureContainer::getChannelTexture()
+	{
+		if (this->channelTexture != NULL)
+		{
+			return this->channelTexture;
+		}
+		if (this->channel < 0 || this->texture == NULL || this->image == NULL)
+		{
+			return NULL;
+		}
+		april::Image::Format format = april::Image::Format::Alpha;
+		if (!april::rendersys->getCaps().textureFormats.has(format))
+		{
+			format = april::rendersys->getNativeTextureFormat(april::Image::Format::RGBA);
+		}
+		this->channelTexture = april::rendersys->createTexture(this->image->w, this->image->h, april::Color::Clear, format);
+		if (this->channelTexture != NULL)
+		{
+			_writeChannelArea(this->channelTexture, this->image, this->channel, grecti(0, 0, this->image->w, this->image->h));
+		}
+		return this->channelTexture;
+	}
+
+	void TextureContainer::destroyChannelTexture()
+	{
+		if (this->channelTexture != NULL)
+		{
+			april::rendersys->destroyTexture(this->channelTexture);
+			this->channelTexture = NULL;
+		}
+	}
+
+	void TextureContainer::resetArea()
+	{
+		this->skyline.clear();
+		this->skyline += gvec2i(0, 0);
+		this->usedArea = 0;
+		this->whiteRect.set(0, 0, 0, 0);
+	}
+
+	float TextureContainer::getOccupancy() const
+	{
+		if (this->texture == NULL || this->texture->getWidth() == 0 || this->texture->getHeight() == 0)
+		{
+			return 0.0f;
+		}
+		return ((float)this->usedArea / (this->texture->getWidth() * this->texture->getHeight()));
+	}
+
 	BorderTextureContainer::BorderTextureContainer(float borderThickness) :
 		TextureContainer()
 	{
@@ -231,6 +672,41 @@ namespace atres
 		return new BorderTextureContainer(this->borderThickness);
 	}
 
+	TextureAtlasPool::TextureAtlasPool(int textureSize)
+	{
+		this->textureSize = textureSize;
+	}
+
+	TextureAtlasPool::~TextureAtlasPool()
+	{
+		foreach (TextureContainer*, it, this->textureContainers)
+		{
+			delete (*it);
+		}
+	}
+
+	harray<april::Texture*> TextureAtlasPool::getTextures() const
+	{
+		harray<april::Texture*> result;
+		foreachc (TextureContainer*, it, this->textureContainers)
+		{
+			result += (*it)->texture;
+		}
+		return result;
+	}
+
+	float TextureAtlasPool::getOccupancy() const
+	{
+		int64_t usedArea = 0;
+		int64_t textureArea = 0;
+		foreachc (TextureContainer*, it, this->textureContainers)
+		{
+			usedArea += (*it)->usedArea;
+			textureArea += (*it)->texture->getWidth() * (*it)->texture->getHeight();
+		}
+		return (textureArea > 0 ? (float)((double)usedArea / textureArea) : 0.0f);
+	}
+
 	CacheEntryBasicText::CacheEntryBasicText() :
 		horizontal(Horizontal::CenterWrapped),
 		vertical(Vertical::Center)
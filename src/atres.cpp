@@ -23,7 +23,9 @@ namespace atres
 	static hversion version(5, 0, 0);
 
 	static int textureSize = 1024;
+	static int minTextureSize = 128;
 	static bool allowAlphaTextures = true;
+	static float borderThicknessStep = 0.01f;
 
 	void init()
 	{
@@ -56,6 +58,16 @@ namespace atres
 		textureSize = value;
 	}
 
+	int getMinTextureSize()
+	{
+		return minTextureSize;
+	}
+
+	void setMinTextureSize(const int& value)
+	{
+		minTextureSize = value;
+	}
+
 	bool isAllowAlphaTextures()
 	{
 		return allowAlphaTextures;
@@ -66,4 +78,19 @@ namespace atres
 		allowAlphaTextures = value;
 	}
 
+	float getBorderThicknessStep()
+	{
+		return borderThicknessStep;
+	}
+
+	void setBorderThicknessStep(const float& value)
+	{
+		if (value <= 0.0f)
+		{
+			hlog::warn(logTag, "Border thickness step has to be greater than 0!");
+			return;
+		}
+		borderThicknessStep = value;
+	}
+
 }